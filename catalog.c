@@ -0,0 +1,318 @@
+/**
+ * @file catalog.c
+ * @author TEAM PINE
+ * @brief: implements functionality for the catalog module.
+ * The catalog loads each map once, and hands out grids
+ * that share its terrain, one per game.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/* lstat() is POSIX, not C11 */
+#define _POSIX_C_SOURCE 200809L
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "grid.h"       /* grid module */
+#include "catalog.h"    /* self */
+
+/******** static function prototypes *******/
+static grid_t* loadMap(const char* path);
+static bool catalog_add(catalog_t* catalog, const char* path, grid_t* map);
+static bool isMapName(const char* name);
+static char* joinPath(const char* dir, const char* name);
+static int compareNames(const void* a, const void* b);
+
+/******** module constants *******/
+static const int InitialMapSlots = 8;   /* catalog arrays grow from here */
+
+/************** Exported functions ***************/
+
+/**
+ * @brief: constructor.
+ * See catalog.h for detailed documentation.
+ */
+catalog_t*
+catalog_new(void)
+{
+  catalog_t* catalog = malloc(sizeof(*catalog));
+  if (catalog == NULL) {
+    return NULL;
+  }
+  catalog->numMaps = 0;
+  catalog->capacity = InitialMapSlots;
+  catalog->paths = calloc(catalog->capacity, sizeof(char*));
+  catalog->maps = calloc(catalog->capacity, sizeof(grid_t*));
+  if (catalog->paths == NULL || catalog->maps == NULL) {
+    catalog_delete(catalog);
+    return NULL;
+  }
+  return catalog;
+}
+
+
+/**
+ * @brief: function to load every map in a directory tree.
+ * See catalog.h for detailed documentation.
+ */
+int
+catalog_addDirectory(catalog_t* catalog, const char* dir)
+{
+  if (catalog == NULL || dir == NULL) {
+    return -1;
+  }
+
+  DIR* dp = opendir(dir);
+  if (dp == NULL) {
+    flog_s(stderr, "catalog: could not read directory '%s'", dir);
+    return -1;
+  }
+
+  /* collect the names first, so that maps are added in order */
+  int numNames = 0;
+  int namesCapacity = InitialMapSlots;
+  char** names = malloc(namesCapacity * sizeof(char*));
+  struct dirent* entry;
+  while (names != NULL && (entry = readdir(dp)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;     /* ".", ".." and hidden files */
+    }
+    if (numNames == namesCapacity) {
+      namesCapacity *= 2;
+      char** grown = realloc(names, namesCapacity * sizeof(char*));
+      if (grown == NULL) {
+        break;
+      }
+      names = grown;
+    }
+    char* name = malloc(strlen(entry->d_name) + 1);
+    if (name == NULL) {
+      break;
+    }
+    strcpy(name, entry->d_name);
+    names[numNames++] = name;
+  }
+  closedir(dp);
+  if (names == NULL) {
+    return -1;
+  }
+  qsort(names, numNames, sizeof(char*), compareNames);
+
+  int before = catalog->numMaps;
+  for (int i = 0; i < numNames; i++) {
+    char* path = joinPath(dir, names[i]);
+    struct stat info;
+    if (path != NULL && lstat(path, &info) == 0) {
+      if (S_ISDIR(info.st_mode)) {
+        catalog_addDirectory(catalog, path);
+      } else if (S_ISLNK(info.st_mode)) {
+        /* follow links to maps, but never into directories,
+           which could lead back up the tree */
+        if (stat(path, &info) == 0 && S_ISREG(info.st_mode) && isMapName(names[i])) {
+          catalog_find(catalog, path);
+        }
+      } else if (S_ISREG(info.st_mode) && isMapName(names[i])) {
+        catalog_find(catalog, path);
+      }
+    }
+    free(path);
+    free(names[i]);
+  }
+  free(names);
+
+  return catalog->numMaps - before;
+}
+
+
+/**
+ * @brief: function to find a map by its path, loading it if need be.
+ * See catalog.h for detailed documentation.
+ */
+int
+catalog_find(catalog_t* catalog, const char* path)
+{
+  if (catalog == NULL || path == NULL) {
+    return -1;
+  }
+
+  for (int i = 0; i < catalog->numMaps; i++) {
+    if (strcmp(catalog->paths[i], path) == 0) {
+      return i;
+    }
+  }
+
+  /* not seen yet: load it now */
+  grid_t* map = loadMap(path);
+  if (map == NULL) {
+    return -1;
+  }
+  if (!catalog_add(catalog, path, map)) {
+    grid_delete(map);
+    return -1;
+  }
+  return catalog->numMaps - 1;
+}
+
+
+/**
+ * @brief: function to get a grid over a map, for a new game.
+ * See catalog.h for detailed documentation.
+ */
+grid_t*
+catalog_share(catalog_t* catalog, int index)
+{
+  if (catalog == NULL || index < 0 || index >= catalog->numMaps) {
+    return NULL;
+  }
+  return grid_share(catalog->maps[index]);
+}
+
+
+/**
+ * @brief: function to free a catalog and its maps.
+ * See catalog.h for detailed documentation.
+ */
+void
+catalog_delete(catalog_t* catalog)
+{
+  if (catalog == NULL) {
+    return;
+  }
+  for (int i = 0; i < catalog->numMaps; i++) {
+    free(catalog->paths[i]);
+    grid_delete(catalog->maps[i]);
+  }
+  free(catalog->paths);
+  free(catalog->maps);
+  free(catalog);
+}
+
+
+/**************** Static Functions ******************/
+
+/**
+ * @brief: loads and validates the map at path.
+ *
+ * Returns:
+ * @return grid_t*: the map, ready to play on.
+ * @return NULL: the file could not be read, is not a valid map,
+ * or has no room floor cells; the reason is logged.
+ */
+static grid_t*
+loadMap(const char* path)
+{
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    flog_s(stderr, "catalog: could not open '%s'", path);
+    return NULL;
+  }
+  grid_t* map = grid_init(fp);
+  fclose(fp);
+
+  if (map == NULL) {
+    flog_s(stderr, "catalog: '%s' is not a valid map", path);
+    return NULL;
+  }
+
+  /* players and gold need somewhere to go */
+  if (map->numOpenCells == 0) {
+    flog_s(stderr, "catalog: '%s' has no room floor cells", path);
+    grid_delete(map);
+    return NULL;
+  }
+  return map;
+}
+
+/**
+ * @brief: appends a map and a copy of its path to the catalog,
+ * growing its arrays if need be.
+ *
+ * Returns:
+ * @return true: added; the catalog now owns map.
+ * @return false: out of memory; the catalog is unchanged.
+ */
+static bool
+catalog_add(catalog_t* catalog, const char* path, grid_t* map)
+{
+  if (catalog->numMaps == catalog->capacity) {
+    int capacity = catalog->capacity * 2;
+    char** paths = realloc(catalog->paths, capacity * sizeof(char*));
+    if (paths == NULL) {
+      return false;
+    }
+    catalog->paths = paths;
+    grid_t** maps = realloc(catalog->maps, capacity * sizeof(grid_t*));
+    if (maps == NULL) {
+      return false;
+    }
+    catalog->maps = maps;
+    catalog->capacity = capacity;
+  }
+
+  char* copy = malloc(strlen(path) + 1);
+  if (copy == NULL) {
+    return false;
+  }
+  strcpy(copy, path);
+
+  catalog->paths[catalog->numMaps] = copy;
+  catalog->maps[catalog->numMaps] = map;
+  catalog->numMaps++;
+  return true;
+}
+
+/**
+ * @brief: tells whether a file name is that of a map:
+ * a text map (".txt") or a compiled one (".map").
+ */
+static bool
+isMapName(const char* name)
+{
+  size_t length = strlen(name);
+  if (length < 4) {
+    return false;
+  }
+  const char* extension = name + length - 4;
+  return strcmp(extension, ".txt") == 0 || strcmp(extension, ".map") == 0;
+}
+
+/**
+ * @brief: joins a directory and a name in it into a new path,
+ * which the caller must free; NULL if out of memory.
+ */
+static char*
+joinPath(const char* dir, const char* name)
+{
+  size_t dirLength = strlen(dir);
+  bool slash = dirLength > 0 && dir[dirLength - 1] == '/';
+
+  char* path = malloc(dirLength + strlen(name) + 2);
+  if (path == NULL) {
+    return NULL;
+  }
+  strcpy(path, dir);
+  if (!slash) {
+    strcat(path, "/");
+  }
+  strcat(path, name);
+  return path;
+}
+
+/**
+ * @brief: orders file names for qsort().
+ */
+static int
+compareNames(const void* a, const void* b)
+{
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
@@ -0,0 +1,121 @@
+/**
+ * @file catalog.h
+ * @author TEAM PINE
+ * @brief: exports functionality for the catalog module.
+ * A catalog holds every map a server may play, each loaded,
+ * validated and segmented once, so that starting a game on a map
+ * costs a grid_share() of it rather than reading and parsing the file.
+ * The catalog's own grids are never played on: each game gets its
+ * own grid over the same terrain, with its own gold and players.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef __CATALOG_H
+#define __CATALOG_H
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "grid.h"       /* grid module */
+
+/**
+ * @brief: the maps a server may play, in the order they were added.
+ * maps[i] was loaded from paths[i].
+ */
+typedef struct catalog {
+  char** paths;         /* path of each map, as given or as found */
+  grid_t** maps;        /* each map as loaded; never played on */
+  int numMaps;          /* maps in the catalog */
+  int capacity;         /* slots allocated in paths and maps */
+} catalog_t;
+
+
+/**
+ * @brief: constructor.
+ *
+ * Returns:
+ * @return catalog_t*: an empty catalog.
+ * @return NULL: out of memory.
+ *
+ * NOTE: the caller must later free it by calling catalog_delete().
+ */
+catalog_t* catalog_new(void);
+
+
+/**
+ * @brief: function to load every map in a directory,
+ * and in its subdirectories, into the catalog.
+ *
+ * Files are taken to be maps if their names end in ".txt"
+ * (text maps) or ".map" (maps compiled by mapc), and are added
+ * in order of their paths. Symbolic links to maps are followed,
+ * but links to directories are not, so a link loop cannot
+ * recurse without end. Files that are not valid maps, or have
+ * no room floor for players and gold, are logged and skipped.
+ *
+ * Inputs:
+ * @param catalog: the catalog.
+ * @param dir: path of the directory.
+ *
+ * Returns:
+ * @return int: the number of maps added.
+ * @return -1: NULL catalog or dir, or dir could not be read.
+ */
+int catalog_addDirectory(catalog_t* catalog, const char* dir);
+
+
+/**
+ * @brief: function to find a map in the catalog by its path,
+ * loading it into the catalog if it is not there yet.
+ *
+ * Inputs:
+ * @param catalog: the catalog.
+ * @param path: path of the map, as given to catalog_addDirectory()
+ * joined with the file's name, or any other path.
+ *
+ * Returns:
+ * @return int: the map's index in the catalog.
+ * @return -1: NULL arguments, the file could not be read,
+ * is not a valid map, or out of memory.
+ */
+int catalog_find(catalog_t* catalog, const char* path);
+
+
+/**
+ * @brief: function to get a grid over a map in the catalog,
+ * on which to start a game.
+ *
+ * Inputs:
+ * @param catalog: the catalog.
+ * @param index: the map's index, from 0 to numMaps - 1.
+ *
+ * Returns:
+ * @return grid_t*: a new grid, as the map was loaded (see grid_share()).
+ * @return NULL: NULL catalog, index out of range, or out of memory.
+ *
+ * NOTE: the caller must later free it by calling grid_delete(),
+ * which it may do before or after catalog_delete().
+ */
+grid_t* catalog_share(catalog_t* catalog, int index);
+
+
+/**
+ * @brief: function to free a catalog and its maps.
+ *
+ * Inputs:
+ * @param catalog: the catalog; may be NULL.
+ *
+ * Returns: None.
+ *
+ * NOTE: grids from catalog_share() stay valid; the terrain they share
+ * is freed with the last of them.
+ */
+void catalog_delete(catalog_t* catalog);
+
+#endif /* __CATALOG_H */
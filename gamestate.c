@@ -15,6 +15,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "player.h"     /* player module */
 #include "grid.h"       /* grid module */
@@ -24,41 +25,56 @@
 #include "log.h"
 
 /********* static function prototypes **********/
-static void gamestate_initPlayers(gamestate_t* state);
-static void gamestate_initGold(gamestate_t* state);
-static void gamestate_initGrid(gamestate_t* state, FILE* mapFile);
+static void gamestate_initPlayers(gamestate_t* state, int maxPlayers);
+static void gamestate_initGold(gamestate_t* state, int numPiles, int totalGold);
 static void gamestate_initSpectator(gamestate_t* state);
 static void gamestate_playersDeleteHelper(gamestate_t* state);
 
+/******** module constants *******/
+/* player labels, in the order they are handed out:
+   every printable character but the map's " .#|-+", gold's '*' and '@' */
+static const char PlayerLabels[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+  "abcdefghijklmnopqrstuvwxyz"
+  "0123456789"
+  "!\"$%&'(),/:;<=>?[\\]^_`{}~";
+static const int InitialPlayerSlots = 32;   /* players array grows from here */
+static const int InitialSpectatorSlots = 4; /* spectators array grows from here */
+
 
 /**
  * @brief constructor.
- * 
- * Inputs:
- * @param mapFile: a FILE pointer to the opened file containing map data.
- * 
- * Returns:
- * @return gamestate_t*: the initialized game instance.
- * @return NULL: an error occured allocating memory for the gamestate.
+ * See gamestate.h for detailed documentation.
  */
 gamestate_t*
-gamestate_init(FILE* mapFile)
+gamestate_init(FILE* mapFile, int numPiles, int totalGold, int maxPlayers)
+{
+  return gamestate_new(grid_init(mapFile), numPiles, totalGold, maxPlayers);
+}
+
+/**
+ * @brief constructor, for a grid already loaded.
+ * See gamestate.h for detailed documentation.
+ */
+gamestate_t*
+gamestate_new(grid_t* grid, int numPiles, int totalGold, int maxPlayers)
 {
   gamestate_t* state = malloc(sizeof(*state));
   if (state == NULL) {
     flog_v(stderr, "Error allocating memory for gamestate.\n");
+    grid_delete(grid);
     return NULL;
   }
   // Initialize players seen
   state->players_seen = 0;
   // Initialize grid field
-  gamestate_initGrid(state, mapFile);
+  state->masterGrid = grid;
 
   // Initialize gold field
-  gamestate_initGold(state);
+  gamestate_initGold(state, numPiles, totalGold);
 
   // Initialize player array field
-  gamestate_initPlayers(state);
+  gamestate_initPlayers(state, maxPlayers);
 
   // Initialize spectator field
   gamestate_initSpectator(state);
@@ -68,12 +84,31 @@ gamestate_init(FILE* mapFile)
 
 /**
  * @brief: initializes array to hold players in the game. 
+ * The array starts small and is grown by gamestate_addPlayer().
+ * Also sets up the versions of, and the grouping of players by,
+ * each room and passage of the map, so the master grid
+ * must be set first.
  * This function allocates memory which must be free'd later
  * by calling gamestate_closeGame().
  */
 static void 
-gamestate_initPlayers(gamestate_t* state){
-  state->players = calloc(26, sizeof(player_t));
+gamestate_initPlayers(gamestate_t* state, int maxPlayers){
+  state->maxPlayers = maxPlayers;
+  state->idleAfter = 0;
+  state->evictAfter = 0;
+  state->players_capacity = InitialPlayerSlots;
+  state->players = calloc(state->players_capacity, sizeof(player_t*));
+  state->visibility = NULL;
+  state->visibility_size = 0;
+  state->segmentVersion = NULL;
+  state->segmentStart = NULL;
+  state->segmentPlayers = NULL;
+
+  if (state->masterGrid != NULL) {
+    int numSegments = state->masterGrid->numRooms + state->masterGrid->numPassages;
+    state->segmentVersion = calloc(numSegments + 1, sizeof(int));
+    state->segmentStart = calloc(numSegments + 2, sizeof(int));
+  }
 }
 
 /**
@@ -82,27 +117,27 @@ gamestate_initPlayers(gamestate_t* state){
  * See gamestate.h for detailed documentation.
  */
 static void 
-gamestate_initGold(gamestate_t* state){
-  state->gameGold = gold_init(26);
-}
-
-/**
- * @brief: initializes the master grid 
- * for the current session of the game. .
- */
-static void
-gamestate_initGrid(gamestate_t* state, FILE* mapFile){
-  state->masterGrid = grid_init(mapFile);
+gamestate_initGold(gamestate_t* state, int numPiles, int totalGold){
+  state->gameGold = gold_init(numPiles, totalGold);
 }
 
 /**
- * @brief: initializes the spectator 
+ * @brief: initializes the array of spectators
  * in the current session of the game.
- * The spectator is set to NULL until one joins the game.
+ * The array starts empty and is grown by gamestate_addSpectator().
+ * Spectators get every frame until the server sets spectatorInterval
+ * and spectatorRefresh.
  */
 static void
 gamestate_initSpectator(gamestate_t* state){
-  state->spectator = NULL;
+  state->numSpectators = 0;
+  state->spectators_capacity = InitialSpectatorSlots;
+  state->spectators = calloc(state->spectators_capacity, sizeof(spectator_t*));
+  state->spectatorInterval = 0;
+  state->spectatorRefresh = SPECTATOR_EVERY;
+  state->spectatorFrame = NULL;
+  state->spectatorFrameVersion = 0;
+  state->now = 0;
 }
 
 /**
@@ -144,7 +179,9 @@ gamestate_playersDeleteHelper(gamestate_t* state){
  * 
  * The gamestate marks empty player slots with a NULL flag,
  * and players are added sequentially as they arrive, 
- * from index 0 onwards up to index 25.
+ * from index 0 onwards; a player's index is its id,
+ * and the array grows as players join.
+ * There is always at least one NULL slot after the last player.
  * A plausible way for the caller to check nonexistence
  * of players or count the number of players is to count
  * until the first NULL in the array.
@@ -157,98 +194,189 @@ gamestate_getPlayers(gamestate_t* state)
 
 
 /**
- * @brief: function to add players to the game.
- *  
- * Inputs:
- * @param state: a pointer to the gamestate 
- * for the current game session.
- * @param player: the player to add to the game.
- * 
- * Returns: None.
- * 
- * NOTE: The game accomodates a maximum of 26 players.
- * If 26 players already joined the game beforehand,
- * a new join request will be denied and the 
- * prospective player will be sent a message that
- * the game is full.
+ * @brief: function to check whether the game
+ * can take any more players.
+ * See gamestate.h for detailed documentation.
  */
-void
-gamestate_addPlayer(gamestate_t* state, player_t* player)
+bool
+gamestate_isFull(gamestate_t* state)
+{
+  if (state == NULL) {
+    return true;
+  }
+
+  /* players who have left free their slots */
+  int inGame = 0;
+  for (int i = 0; i < state->players_seen; i++) {
+    if (player_isActive(state->players[i])) {
+      inGame++;
+    }
+  }
+  return inGame >= state->maxPlayers;
+}
+
+
+/**
+ * @brief: function to choose the label for the next player.
+ * See gamestate.h for detailed documentation.
+ */
+char
+gamestate_nextLabel(gamestate_t* state)
 {
-  /* if gamestate is not NULL */
-  if (state != NULL && player != NULL) {
+  int numLabels = strlen(PlayerLabels);
+  int id = (state != NULL) ? state->players_seen : 0;
 
-    /* if there's still space for more players */
-    if (state->players_seen < 26) {
+  /* every label has not been handed out yet */
+  if (id < numLabels) {
+    return PlayerLabels[id];
+  }
 
-      /* add new player, increment num of players seen */
-      state->players[state->players_seen++] = player;
+  /* reuse a label no player still in the game holds */
+  bool inUse[128] = { false };
+  for (int i = 0; i < state->players_seen; i++) {
+    if (player_isActive(state->players[i])) {
+      inUse[state->players[i]->letter & 0x7f] = true;
+    }
+  }
+  for (int i = 0; i < numLabels; i++) {
+    if (!inUse[(int) PlayerLabels[i]]) {
+      return PlayerLabels[i];
     }
-    else {
+  }
+
+  /* more players in the game than labels */
+  return PlayerLabels[id % numLabels];
+}
+
 
-      /* if game is full, send QUIT message */
-      player_send(player, "QUIT Game is full.");
+/**
+ * @brief: function to add players to the game.
+ * See gamestate.h for detailed documentation.
+ */
+bool
+gamestate_addPlayer(gamestate_t* state, player_t* player)
+{
+  /* if gamestate is not NULL, and there's still space for more players */
+  if (state != NULL && player != NULL && !gamestate_isFull(state)) {
+
+    /* grow the array, keeping a NULL slot after the last player */
+    if (state->players_seen + 1 >= state->players_capacity) {
+      int capacity = state->players_capacity * 2;
+      player_t** players = realloc(state->players, capacity * sizeof(player_t*));
+      if (players == NULL) {
+        flog_v(stderr, "Error allocating memory for players. Stop.\n");
+        return false;
+      }
+      for (int i = state->players_capacity; i < capacity; i++) {
+        players[i] = NULL;
+      }
+      state->players = players;
+      state->players_capacity = capacity;
     }
+
+    /* add new player, increment num of players seen */
+    player->id = state->players_seen;
+    state->players[state->players_seen++] = player;
+    return true;
   }
+  return false;
 }
 
 
 /**
  * @brief: function to add a spectator to the game.
- *  
- * @param state: a pointer to the gamestate 
- * for the current game session.
- * @param address: the address of the spectator to add to the game.
- * 
- * NOTE: The game can only have a single spectator at a time.
- * If there's a spectator in the game, the old spectator will
- * be sent a QUIT message and replaced by the new spectator.
- * 
- * Returns: None
+ * See gamestate.h for detailed documentation.
  */
-void
+spectator_t*
 gamestate_addSpectator(gamestate_t* state, addr_t address)
 {
   /* if game is not NULL */
   if (state != NULL) {
 
-    /* if a spectator exists in game, replace them */
-    if (state->spectator != NULL) {
-      spectator_send(state->spectator, "QUIT You have been replaced by a new spectator.");
-      spectator_delete(state->spectator);
+    /* a spectator asking again keeps its place */
+    spectator_t* spectator = gamestate_findSpectatorByAddress(state, address);
+    if (spectator != NULL) {
+      return spectator;
+    }
+
+    /* grow the array if it is full */
+    if (state->numSpectators == state->spectators_capacity) {
+      int capacity = state->spectators_capacity * 2;
+      spectator_t** spectators = realloc(state->spectators, capacity * sizeof(spectator_t*));
+      if (spectators == NULL) {
+        flog_v(stderr, "Error allocating memory for spectators. Stop.\n");
+        return NULL;
+      }
+      state->spectators = spectators;
+      state->spectators_capacity = capacity;
     }
 
     /* save new spectator */
-    state->spectator = spectator_new(address);
+    if ((spectator = spectator_new(address)) != NULL) {
+      state->spectators[state->numSpectators++] = spectator;
+    }
+    return spectator;
+  }
+  return NULL;
+}
+
+
+/**
+ * @brief: function to remove a spectator from the game
+ * and delete it.
+ * See gamestate.h for detailed documentation.
+ */
+void
+gamestate_removeSpectator(gamestate_t* state, spectator_t* spectator)
+{
+  if (state != NULL && spectator != NULL) {
+    for (int i = 0; i < state->numSpectators; i++) {
+      if (state->spectators[i] == spectator) {
+
+        /* move the last spectator into the gap */
+        state->spectators[i] = state->spectators[--state->numSpectators];
+        state->spectators[state->numSpectators] = NULL;
+        spectator_delete(spectator);
+        return;
+      }
+    }
   }
 }
 
 
 /**
  * @brief: a function that checks if a given address
- * belongs to the current spectator in the game.
- * 
- * Inputs:
- * @param state: the gamestate for the current session of the game.
- * @param address: address to check (addr_t struct)
- * 
- * Returns:
- * @return true: the address matches the spectator's address.
- * @return false: the address does not match current spectator.
+ * belongs to a spectator in the game.
+ * See gamestate.h for detailed documentation.
  */
 bool
 gamestate_isSpectator(gamestate_t* state, addr_t address)
+{
+  return gamestate_findSpectatorByAddress(state, address) != NULL;
+}
+
+
+/**
+ * @brief: a function to find a spectator in the game
+ * that matches a given address.
+ * See gamestate.h for detailed documentation.
+ */
+spectator_t*
+gamestate_findSpectatorByAddress(gamestate_t* state, addr_t address)
 {
   /* defensive checks */
-  if (state != NULL && state->spectator != NULL) {
+  if (state != NULL) {
 
-    /* check if address matches that of spectator in game */
-    spectator_t* spectator = state->spectator;
-    return message_eqAddr(address, spectator->address);
+    /* check if address matches that of a spectator in game */
+    for (int i = 0; i < state->numSpectators; i++) {
+      if (message_eqAddr(address, state->spectators[i]->address)) {
+        return state->spectators[i];
+      }
+    }
   }
 
-  /* if either is NULL, return false */
-  return false;
+  /* if none matched, or state is NULL, return NULL */
+  return NULL;
 }
 
 
@@ -287,6 +415,159 @@ gamestate_findPlayerByAddress(gamestate_t* state, addr_t address)
   return NULL;
 }
 
+/**
+ * @brief: function to work out which players can see each other.
+ * See gamestate.h for detailed documentation.
+ */
+void
+gamestate_updateVisibility(gamestate_t* state)
+{
+  if (state == NULL) {
+    return;
+  }
+
+  grid_t* grid = state->masterGrid;
+  if (grid == NULL || state->segmentStart == NULL) {
+    return;
+  }
+
+  /* count the players still in the game, in each room or passage;
+     players who left are not counted, so the matrix stays
+     as small as the game, however many have come and gone */
+  int n = state->players_seen;
+  int numSegments = grid->numRooms + grid->numPassages;
+  int* start = state->segmentStart;
+  memset(start, 0, (numSegments + 2) * sizeof(int));
+  int active = 0;
+  for (int i = 0; i < n; i++) {
+    player_t* player = state->players[i];
+    if (player_isActive(player)) {
+      start[grid_segmentAt(grid, player->x, player->y)]++;
+      active++;
+    }
+  }
+
+  /* one cell per ordered pair of those players */
+  if (active != state->visibility_size || state->visibility == NULL) {
+    unsigned char* visibility = realloc(state->visibility, (size_t) active * active + 1);
+    player_t** grouped = realloc(state->segmentPlayers, (active + 1) * sizeof(player_t*));
+    if (visibility != NULL) {
+      state->visibility = visibility;
+    }
+    if (grouped != NULL) {
+      state->segmentPlayers = grouped;
+    }
+    if (visibility == NULL || grouped == NULL) {
+      flog_v(stderr, "Error allocating memory for visibility. Stop.\n");
+      state->visibility_size = 0;
+      return;
+    }
+    state->visibility_size = active;
+  }
+
+  /* group them by room or passage, placing them last first,
+     so each group keeps the order players joined in;
+     a player's place in the grouping is its slot in the matrix */
+  for (int s = 1; s <= numSegments + 1; s++) {
+    start[s] += start[s - 1];
+  }
+  for (int i = n - 1; i >= 0; i--) {
+    player_t* player = state->players[i];
+    if (player_isActive(player)) {
+      int slot = --start[grid_segmentAt(grid, player->x, player->y)];
+      state->segmentPlayers[slot] = player;
+      player->slot = slot;
+    }
+  }
+
+  /* a player sees only itself, unless another is in sight in its room */
+  memset(state->visibility, 0, (size_t) active * active);
+  for (int i = 0; i < active; i++) {
+    state->visibility[i * active + i] = 1;
+  }
+
+  /* check each unordered pair in the same room or passage once,
+     and mirror it; in passages, only neighbours see each other */
+  for (int segment = 1; segment <= numSegments; segment++) {
+    for (int i = start[segment]; i < start[segment + 1]; i++) {
+      player_t* a = state->segmentPlayers[i];
+      for (int j = i + 1; j < start[segment + 1]; j++) {
+        player_t* b = state->segmentPlayers[j];
+        bool sees = grid_isPlayerVisible(state, grid, a, b);
+        state->visibility[i * active + j] = sees;
+        state->visibility[j * active + i] = sees;
+      }
+    }
+  }
+}
+
+
+/**
+ * @brief: function to note that what may be seen at a cell has changed.
+ * See gamestate.h for detailed documentation.
+ */
+void
+gamestate_touchCell(gamestate_t* state, int x, int y)
+{
+  if (state == NULL || state->segmentVersion == NULL) {
+    return;
+  }
+  state->segmentVersion[grid_segmentAt(state->masterGrid, x, y)]++;
+}
+
+
+/**
+ * @brief: function to check whether a player is due a new DISPLAY.
+ * See gamestate.h for detailed documentation.
+ */
+bool
+gamestate_needsDisplay(gamestate_t* state, player_t* player)
+{
+  if (state == NULL || player == NULL) {
+    return false;
+  }
+  if (state->segmentVersion == NULL) {
+    return true;
+  }
+  int segment = grid_segmentAt(state->masterGrid, player->x, player->y);
+  return player->shownSegment != segment
+         || player->shownVersion != state->segmentVersion[segment];
+}
+
+
+/**
+ * @brief: function to note that a player was just sent a DISPLAY.
+ * See gamestate.h for detailed documentation.
+ */
+void
+gamestate_markDisplayed(gamestate_t* state, player_t* player)
+{
+  if (state == NULL || player == NULL || state->segmentVersion == NULL) {
+    return;
+  }
+  int segment = grid_segmentAt(state->masterGrid, player->x, player->y);
+  player->shownSegment = segment;
+  player->shownVersion = state->segmentVersion[segment];
+}
+
+
+/**
+ * @brief: function to look up whether one player can see another.
+ * See gamestate.h for detailed documentation.
+ */
+bool
+gamestate_canSee(gamestate_t* state, player_t* viewer, player_t* other)
+{
+  if (state == NULL || viewer == NULL || other == NULL || state->visibility == NULL) {
+    return false;
+  }
+  int n = state->visibility_size;
+  if (viewer->slot < 0 || other->slot < 0 || viewer->slot >= n || other->slot >= n) {
+    return false;
+  }
+  return state->visibility[viewer->slot * n + other->slot];
+}
+
 /**
  * @brief: function to close the gamestate tracker
  * for a game instance.
@@ -298,11 +579,19 @@ void gamestate_closeGame(gamestate_t* state){
   // Close grid
   grid_delete(state->masterGrid);
 
-  // Close spectator
-  spectator_delete(state->spectator);
+  // Close spectators
+  for (int i = 0; i < state->numSpectators; i++) {
+    spectator_delete(state->spectators[i]);
+  }
+  free(state->spectators);
+  free(state->spectatorFrame);
   
-  // Close players array
+  // Close players array, and who sees whom
   gamestate_playersDeleteHelper(state);
+  free(state->visibility);
+  free(state->segmentVersion);
+  free(state->segmentStart);
+  free(state->segmentPlayers);
 
   // Close gold
   gold_delete(state->gameGold);
@@ -31,9 +31,25 @@
  */
 typedef struct game {
   grid_t* masterGrid;           /* master grid */
-  spectator_t* spectator;       /* single spectator -- is NULL if no spectator in game */ 
-  player_t** players;        /* array of players */
+  spectator_t** spectators;     /* spectators watching the game */
+  int numSpectators;            /* spectators in the array */
+  int spectators_capacity;      /* slots allocated in the spectators array */
+  double spectatorInterval;     /* least time (seconds) between frames to a spectator */
+  spectator_refresh_t spectatorRefresh;   /* how to refresh spectators */
+  char* spectatorFrame;         /* last frame rendered for spectators, NULL if none */
+  int spectatorFrameVersion;    /* bumped whenever spectatorFrame changes */
+  double now;                   /* game time (seconds) of the message being handled */
+  player_t** players;        /* array of players, grown as they join */
   int players_seen;             /* track players seen -- whether in game or left */
+  int players_capacity;         /* slots allocated in the players array */
+  int maxPlayers;               /* most players that may be in the game at once */
+  double idleAfter;             /* silence (seconds) after which a player is idle; 0 for never */
+  double evictAfter;            /* silence (seconds) after which a player is evicted; 0 for never */
+  unsigned char* visibility;    /* active x active, by player slot: who sees whom this tick */
+  int visibility_size;          /* players in the game when the matrix was built */
+  int* segmentVersion;          /* per room or passage: bumped whenever what is seen there changes */
+  int* segmentStart;            /* players in segment s are segmentPlayers[segmentStart[s] ..] */
+  player_t** segmentPlayers;    /* players still in the game, grouped by room or passage */
   gold_t* gameGold;             /* keep track of gold in the game */
 } gamestate_t;
 
@@ -43,12 +59,34 @@ typedef struct game {
  * 
  * Inputs:
  * @param mapFile: a FILE pointer to the opened file containing map data.
+ * @param numPiles: the number of gold piles to share the gold among.
+ * @param totalGold: the number of gold nuggets in the game.
+ * @param maxPlayers: the most players that may join the game.
  * 
  * Returns:
  * @return gamestate_t*: the initialized game instance.
  * @return NULL: an error occured allocating memory for the gamestate.
  */
-gamestate_t* gamestate_init(FILE* mapFile);
+gamestate_t* gamestate_init(FILE* mapFile, int numPiles, int totalGold, int maxPlayers);
+
+
+/**
+ * @brief constructor, for a map already loaded,
+ * e.g. a grid from catalog_share().
+ *
+ * Inputs:
+ * @param grid: the master grid for the game; the gamestate takes
+ * it over, and frees it in gamestate_closeGame().
+ * @param numPiles: the number of gold piles to share the gold among.
+ * @param totalGold: the number of gold nuggets in the game.
+ * @param maxPlayers: the most players that may join the game.
+ *
+ * Returns:
+ * @return gamestate_t*: the initialized game instance.
+ * @return NULL: an error occured allocating memory for the gamestate;
+ * the grid has been freed.
+ */
+gamestate_t* gamestate_new(grid_t* grid, int numPiles, int totalGold, int maxPlayers);
 
 
 /**
@@ -67,7 +105,8 @@ gamestate_t* gamestate_init(FILE* mapFile);
  * 
  * The gamestate marks empty player slots with a NULL flag,
  * and players are added sequentially as they arrive, 
- * from index 0 onwards up to index 25.
+ * from index 0 onwards; a player's index is its id.
+ * There is always at least one NULL slot after the last player.
  * A plausible way for the caller to check nonexistence
  * of players or count the number of players is to count
  * until the first NULL in the array.
@@ -77,19 +116,34 @@ player_t** gamestate_getPlayers(gamestate_t* game);
 
 /**
  * @brief: a function that checks if a given address
- * belongs to the current spectator in the game.
+ * belongs to a spectator in the game.
  * 
  * Inputs:
  * @param state: the gamestate for the current session of the game.
  * @param address: address to check (addr_t struct)
  * 
  * Returns:
- * @return true: the address matches the spectator's address.
- * @return false: the address does not match current spectator.
+ * @return true: the address matches a spectator's address.
+ * @return false: the address does not match any spectator.
  */
 bool gamestate_isSpectator(gamestate_t* state, addr_t address);
 
 
+/**
+ * @brief: a function to find a spectator in the game
+ * that matches a given address.
+ * 
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * @param address: the address to check for a match.
+ * 
+ * Returns:
+ * @return spectator_t*: the spectator matching given address.
+ * @return NULL: no matching spectator was found.
+ */
+spectator_t* gamestate_findSpectatorByAddress(gamestate_t* state, addr_t address);
+
+
 /**
  * @brief: a function to find a player in the game
  * that matches a given address.
@@ -105,23 +159,63 @@ bool gamestate_isSpectator(gamestate_t* state, addr_t address);
 player_t* gamestate_findPlayerByAddress(gamestate_t* state, addr_t address);
 
 
+/**
+ * @brief: function to check whether the game
+ * can take any more players.
+ * 
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * 
+ * Returns:
+ * @return true: maxPlayers players are in the game
+ * (or the gamestate is NULL). Players who have quit,
+ * or were evicted, no longer count.
+ * @return false: another player may join.
+ */
+bool gamestate_isFull(gamestate_t* state);
+
+
+/**
+ * @brief: function to choose the label (the letter shown on the map)
+ * for the next player to join the game.
+ * 
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * 
+ * Returns:
+ * @return char: the label.
+ * 
+ * NOTE: labels are drawn from the printable characters that
+ * cannot be confused with the map, gold ('*') or the viewer ('@'):
+ * 'A'-'Z' first, so the first 26 players are labelled as before,
+ * then 'a'-'z', digits and punctuation.
+ * Once those run out, the label of a player who has quit is reused,
+ * so labels stay distinct among players still in the game
+ * as long as there are no more of them than labels.
+ */
+char gamestate_nextLabel(gamestate_t* state);
+
+
 /**
  * @brief: function to add players to the game.
+ * The player's id is set to its index in the players array,
+ * which grows as needed.
  *  
  * Inputs:
  * @param state: a pointer to the gamestate 
  * for the current game session.
  * @param player: the player to add to the game.
  * 
- * Returns: None.
+ * Returns:
+ * @return true: the player was added.
+ * @return false: the game is full, or memory ran out;
+ * the caller still owns the player.
  * 
- * NOTE: The game accomodates a maximum of 26 players.
- * If 26 players already joined the game beforehand,
- * a new join request will be denied and the 
- * prospective player will be sent a message that
- * the game is full.
+ * NOTE: callers should check gamestate_isFull() before
+ * creating the player, and tell the prospective player
+ * that the game is full.
  */
-void gamestate_addPlayer(gamestate_t* state, player_t* player);
+bool gamestate_addPlayer(gamestate_t* state, player_t* player);
 
 
 /**
@@ -132,13 +226,114 @@ void gamestate_addPlayer(gamestate_t* state, player_t* player);
  * for the current game session.
  * @param address: the address of the spectator to add to the game.
  * 
- * NOTE: The game can only have a single spectator at a time.
- * If there's a spectator in the game, the old spectator will
- * be sent a QUIT message and replaced by the new spectator. 
+ * Returns:
+ * @return spectator_t*: the spectator with that address;
+ * if one was already watching, that spectator.
+ * @return NULL: error allocating memory.
+ * 
+ * NOTE: The game may have any number of spectators.
+ */
+spectator_t* gamestate_addSpectator(gamestate_t* game, addr_t address);
+
+
+/**
+ * @brief: function to remove a spectator from the game
+ * and delete it.
+ *  
+ * Inputs:
+ * @param state: a pointer to the gamestate 
+ * for the current game session.
+ * @param spectator: the spectator to remove.
+ * 
+ * Returns: None
+ * 
+ * NOTE: the order of the remaining spectators may change.
+ */
+void gamestate_removeSpectator(gamestate_t* state, spectator_t* spectator);
+
+
+/**
+ * @brief: function to note that what may be seen at a cell has changed:
+ * a player arrived there or left, or took the gold there.
+ * Players in the same room or passage are due a new DISPLAY.
+ *  
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * @param x: x position of the cell.
+ * @param y: y position of the cell.
  * 
  * Returns: None
  */
-void gamestate_addSpectator(gamestate_t* game, addr_t address);
+void gamestate_touchCell(gamestate_t* state, int x, int y);
+
+
+/**
+ * @brief: function to check whether a player's view may have changed
+ * since the last DISPLAY they were sent.
+ * Players see no further than the room they are in
+ * (and, from a passage, only the passage cells next to them),
+ * so their view can only change if they moved to another room
+ * or passage, or if a cell in theirs was touched.
+ *  
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * @param player: the player.
+ * 
+ * Returns:
+ * @return true: the player is due a new DISPLAY.
+ * @return false: the last DISPLAY sent is still accurate.
+ */
+bool gamestate_needsDisplay(gamestate_t* state, player_t* player);
+
+
+/**
+ * @brief: function to note that a player was just sent a DISPLAY
+ * of the game as it stands.
+ *  
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * @param player: the player.
+ * 
+ * Returns: None
+ */
+void gamestate_markDisplayed(gamestate_t* state, player_t* player);
+
+
+/**
+ * @brief: function to work out which players can see each other,
+ * once per tick, after all moves and before any rendering.
+ * Players are first grouped by the room or passage they are in;
+ * only players in the same room or passage can see each other
+ * (in a passage, only from next to each other), so only
+ * those pairs are checked. Line of sight is symmetric
+ * (if A sees B, B sees A), so each pair is checked once,
+ * against the master grid, and the result stored for both.
+ * The matrix covers only the players still in the game, each at
+ * its slot (player->slot), so it does not grow with players who left.
+ *  
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * 
+ * Returns: None
+ */
+void gamestate_updateVisibility(gamestate_t* state);
+
+
+/**
+ * @brief: function to look up, in the matrix built by
+ * gamestate_updateVisibility(), whether one player can see another.
+ *  
+ * Inputs:
+ * @param state: the gamestate for the current session of the game.
+ * @param viewer: the player looking.
+ * @param other: the player looked at.
+ * 
+ * Returns:
+ * @return true: viewer can see other (a player always sees itself).
+ * @return false: viewer cannot see other, either has quit,
+ * or other joined since the matrix was built.
+ */
+bool gamestate_canSee(gamestate_t* state, player_t* viewer, player_t* other);
 
 
 /**
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "grid.h"       /* grid module */
 #include "player.h"     /* player module */
@@ -24,28 +25,24 @@
 
 
 /******** static function prototypes *******/
-static int randomInt(int lower, int upper);
-
-/******** module constants *******/
-static const int TOTALGOLD = 250;     /* the total gold assigned at start of the game. */
+static void placePile(grid_t* grid, gold_t* gold, int pile, int cell);
+static int distributeUniform(grid_t* grid, gold_t* gold, int placed);
+static int distributeBalanced(grid_t* grid, gold_t* gold);
+static int distributeByDistance(grid_t* grid, gold_t* gold);
+static long* distanceWeights(grid_t* grid);
 
 /************** Exported functions ***************/
 
 /**
  * @brief: function to initialize the state of gold
  * in a game instance and scatter gold in the map.
- * 
- * Inputs:
- * @param numPiles: The total desired number of piles of gold to assign.
- * 
- * Returns:
- * @return gold_t*: pointer to a struct holding gold information.
+ * See gold.h for detailed documentation.
  */
 gold_t*
-gold_init(int numPiles)
+gold_init(int numPiles, int totalGold)
 {
-  /* cannot allocate negative number of gold piles */
-  if (numPiles >= 0) {
+  /* every pile needs at least one nugget */
+  if (numPiles > 0 && numPiles <= totalGold) {
 
     /* allocate memory for gold struct */
     gold_t* gold = malloc(sizeof(gold_t));
@@ -56,22 +53,26 @@ gold_init(int numPiles)
     /* allocate memory for gold counter array */
     gold->goldCounter = calloc(numPiles, sizeof(int));
 
-    int remainder = TOTALGOLD;                          /* track remaining gold */ 
+    int remainder = totalGold;                          /* track remaining gold */ 
     for (int i = 0; i < numPiles - 1; i++) {            /* allocate random counts for numPiles-1 piles */
       int upperBound = (int) (remainder / (numPiles - i));
-      gold->goldCounter[i] = randomInt(1, upperBound);
+      gold->goldCounter[i] = (upperBound > 1) ? randomInt(1, upperBound) : 1;
       remainder -= gold->goldCounter[i];
     }
-    /* allocate remainder to last pile (to add up to 250) */
+    /* allocate remainder to last pile (to add up to totalGold) */
     gold->goldCounter[numPiles - 1] = remainder;
 
-    /* initialize index in piles to ZERO */
-    gold->index = 0;
+    /* nothing collected yet; piles have no position until distributed */
+    gold->numCollected = 0;
+    gold->remaining = totalGold;
+    gold->pileAt = NULL;
+    gold->openIndex = NULL;
+    gold->cols = 0;
 
     /* return created struct */
     return gold;
   }
-  flog_v(stderr, "Attempt to allocate a negative number of gold piles. Stop.\n");
+  flog_v(stderr, "Attempt to allocate an invalid number of gold piles. Stop.\n");
   return NULL; 
 }
 
@@ -95,94 +96,127 @@ gold_delete(gold_t* gold)
   /* if struct is not null, free it's counter then free the struct. */
   if (gold != NULL) {
     free(gold->goldCounter);
+    free(gold->pileAt);
     free(gold);
   }
 }
 
 /**
- * @brief: function to assign a pile of gold to a given player.
- * 
- * Inputs: 
- * @param gold: pointer to a gold struct created using gold_init()
- * @param player: pointer to a player struct 
- * such as the one implemented in player.c and player.h
- * 
- * Returns: None.
+ * @brief: function to give a player the pile of gold
+ * at a given position, if there is one.
+ * See gold.h for detailed documentation.
  */
-void
-gold_assign(gold_t* gold, player_t* player)
+int
+gold_collect(gold_t* gold, player_t* player, int x, int y)
 {
-  /* if both player and gold are not null,
-     and there are still piles of gold remaining in the game,
-     get the next pile of gold and assign to player. */
-  if (gold != NULL && player != NULL) {
-    if (gold->index < gold->numPiles) {
-      player_addGold(player, gold->goldCounter[gold->index++]);
-    }
+  if (gold == NULL || player == NULL || gold->pileAt == NULL) {
+    return 0;
+  }
+
+  /* look the pile up by position, and take it off the map */
+  int open = gold->openIndex[y * gold->cols + x];
+  if (open < 0 || gold->pileAt[open] < 0) {
+    return 0;
   }
+  int pile = gold->pileAt[open];
+  gold->pileAt[open] = -1;
+
+  int nuggets = gold->goldCounter[pile];
+  gold->goldCounter[pile] = 0;
+  gold->numCollected++;
+  gold->remaining -= nuggets;
+  player_addGold(player, nuggets);
+  return nuggets;
 }
 
 
 /**
  * @brief: function to scatter gold in a map,
  * given a map (grid struct) and a gold strict with relevant details.
- * 
- * Inputs:
- * @param grid: pointer to a grid struct wherein the map data is stored.
- * @param gold: pointer to gold struct holding information
- * such as the number of piles to scatter in the map.
- * 
- * Returns: None.
+ * See gold.h for detailed documentation.
  */
 void
-gold_distribute(grid_t* grid, gold_t* gold)
+gold_distribute(grid_t* grid, gold_t* gold, gold_policy_t policy)
 {
-  /* get raw representation of map in the grid. */
-  char** map = grid_getGrid(grid);
-
-  /* initialize counter for number of piles assigned. */
-  int i = 0;
+  if (grid == NULL || gold == NULL) {
+    flog_v(stderr, "Attempt to distribute gold with a NULL grid or gold. Stop.\n");
+    return;
+  }
 
-  /* repeat until desired number of piles is assigned... */
-  while (i < gold->numPiles) {
+  /* index the piles by room floor cell, where they all go;
+     no cell holds a pile yet */
+  free(gold->pileAt);
+  if ((gold->pileAt = malloc((grid->numOpenCells + 1) * sizeof(int))) == NULL) {
+    flog_v(stderr, "Error allocating memory for the gold piles. Stop.\n");
+    return;
+  }
+  for (int i = 0; i < grid->numOpenCells; i++) {
+    gold->pileAt[i] = -1;
+  }
+  gold->openIndex = grid->shared->openIndex;
+  gold->cols = grid->cols;
 
-    /* generate random coordinates */
-    int x = randomInt(1, grid_getColumns(grid));
-    int y = randomInt(1, grid_getRows(grid));
+  /* place as many piles as the policy (and the map) allow */
+  int placed;
+  switch (policy) {
+    case GOLD_BALANCED:
+      placed = distributeBalanced(grid, gold);
+      break;
+    case GOLD_DISTANCE:
+      placed = distributeByDistance(grid, gold);
+      break;
+    default:
+      placed = distributeUniform(grid, gold, 0);
+      break;
+  }
 
-    /* if random coordinates are a valid point,
-       place a line there in the map.
-       if not valid, repeat. */
-    if (map[y][x] == '.') {
-      map[y][x] = '*';
-      i++;
+  /* fold the gold of piles that found no room into the last placed pile */
+  if (placed < gold->numPiles) {
+    flog_d(stderr, "Map only has room for %d gold piles.", placed);
+    if (placed > 0) {
+      for (int i = placed; i < gold->numPiles; i++) {
+        gold->goldCounter[placed - 1] += gold->goldCounter[i];
+      }
+    }
+    else {
+      gold->remaining = 0;    /* no gold could be placed at all */
     }
+    gold->numPiles = placed;
   }
 }
 
 
-/**************** Static Functions ******************/
+/**
+ * @brief: function to parse the name of a gold policy.
+ * See gold.h for detailed documentation.
+ */
+bool
+gold_parsePolicy(const char* name, gold_policy_t* policy)
+{
+  if (name == NULL || policy == NULL) {
+    return false;
+  }
+  if (strcmp(name, "uniform") == 0) {
+    *policy = GOLD_UNIFORM;
+  }
+  else if (strcmp(name, "balanced") == 0) {
+    *policy = GOLD_BALANCED;
+  }
+  else if (strcmp(name, "distance") == 0) {
+    *policy = GOLD_DISTANCE;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
 
 /**
- * @brief: Function to generate a number within a range.
- * calls rand() to generate a random number 
- * then bounds it to expectate range using mod operator.
- * This is handy because rand() doesn't take any arguments
- * and generates unbounded values
- * 
- * Inputs:
- * @param lower: lower bound, inclusive
- * @param upper: upper bound, inclusive
- * 
- * Returns:
- * @return int: a random value between the lower and upper bound.
- * 
- * NOTE: This function returns -1 as an error flag for invalid bounds.
- * If called in a context that may result in incorrect bounds, 
- * The caller may check if the return value is -1
- * To detect errors. 
+ * @brief: function to generate a number within a range.
+ * See gold.h for detailed documentation.
  */
-static int
+int
 randomInt(int lower, int upper)
 {
   /* can only generate a calue within valid bounds... */
@@ -203,4 +237,241 @@ randomInt(int lower, int upper)
   /* if bounds are invalid, print error message, return -1 */
   flog_v(stderr, "Attempt to generate a number with invalid bounds. Stop.\n");
   return -1;
-}
\ No newline at end of file
+}
+
+/**************** Static Functions ******************/
+
+/**
+ * @brief: puts the given pile of gold on a cell (y*cols + x) of the map,
+ * taking the cell out of the free spawn points
+ * and recording the pile's position.
+ */
+static void
+placePile(grid_t* grid, gold_t* gold, int pile, int cell)
+{
+  int x = cell % grid->cols;
+  int y = cell / grid->cols;
+
+  grid_setCell(grid, x, y, '*');
+  grid_claimCell(grid, x, y);
+  gold->pileAt[grid->shared->openIndex[cell]] = pile;
+}
+
+/**
+ * @brief: places piles on free room floor cells chosen uniformly.
+ * Every placement removes the cell from the grid's free set,
+ * so this is a partial Fisher-Yates shuffle of the free cells:
+ * constant time per pile, no retries.
+ * Piles numbered from placed onwards are placed;
+ * those before it have been placed already.
+ *
+ * Returns:
+ * @return int: the number of piles placed, in all.
+ */
+static int
+distributeUniform(grid_t* grid, gold_t* gold, int placed)
+{
+  int x, y;
+  while (placed < gold->numPiles && grid_randomFreeCell(grid, &x, &y)) {
+    placePile(grid, gold, placed, y * grid->cols + x);
+    placed++;
+  }
+  return placed;
+}
+
+/**
+ * @brief: deals piles round-robin across the rooms, in random room order,
+ * each room drawing its cells by a partial Fisher-Yates shuffle
+ * of its own free floor cells. Rooms that run out are skipped.
+ *
+ * Returns:
+ * @return int: the number of piles placed.
+ */
+static int
+distributeBalanced(grid_t* grid, gold_t* gold)
+{
+  int numPiles = gold->numPiles;
+  int numRooms = grid->numRooms;
+  int numFree = grid->numFreeCells;
+
+  /* group the free cells by room (counting sort on room id) */
+  int* start = calloc(numRooms + 2, sizeof(int));
+  int* used = calloc(numRooms + 1, sizeof(int));
+  int* order = malloc((numRooms + 1) * sizeof(int));
+  int* cells = malloc((numFree + 1) * sizeof(int));
+  if (start == NULL || used == NULL || order == NULL || cells == NULL) {
+    free(start); free(used); free(order); free(cells);
+    return distributeUniform(grid, gold, 0);
+  }
+  for (int i = 0; i < numFree; i++) {
+    start[grid->shared->segment[grid->freeCells[i]] + 1]++;
+  }
+  for (int r = 1; r <= numRooms + 1; r++) {
+    start[r] += start[r - 1];
+  }
+  for (int i = 0; i < numFree; i++) {
+    int room = grid->shared->segment[grid->freeCells[i]];
+    cells[start[room] + used[room]++] = grid->freeCells[i];
+  }
+
+  /* shuffle the order in which rooms are dealt to */
+  for (int r = 0; r < numRooms; r++) {
+    order[r] = r + 1;
+    used[r + 1] = 0;
+  }
+  for (int r = numRooms - 1; r > 0; r--) {
+    int k = randomInt(0, r + 1);
+    int temp = order[r]; order[r] = order[k]; order[k] = temp;
+  }
+
+  /* deal one pile per room per round */
+  int placed = 0;
+  bool progress = true;
+  while (placed < numPiles && progress) {
+    progress = false;
+    for (int r = 0; r < numRooms && placed < numPiles; r++) {
+      int room = order[r];
+      int size = start[room + 1] - start[room];
+      if (used[room] < size) {
+        int* slice = cells + start[room];
+        int k = randomInt(used[room], size);
+        int temp = slice[used[room]]; slice[used[room]] = slice[k]; slice[k] = temp;
+        placePile(grid, gold, placed, slice[used[room]++]);
+        placed++;
+        progress = true;
+      }
+    }
+  }
+
+  free(start); free(used); free(order); free(cells);
+  return placed;
+}
+
+/**
+ * @brief: places piles on free room floor cells drawn with probability
+ * proportional to their weight from distanceWeights(), without replacement.
+ * Draws binary-search a prefix sum of the weights; a draw that hits
+ * a cell already used is retried, and after too many retries
+ * the remaining piles are placed uniformly.
+ *
+ * Returns:
+ * @return int: the number of piles placed.
+ */
+static int
+distributeByDistance(grid_t* grid, gold_t* gold)
+{
+  int numPiles = gold->numPiles;
+  int numFree = grid->numFreeCells;
+  long* weights = distanceWeights(grid);
+  long* prefix = malloc((numFree + 1) * sizeof(long));
+  int* cells = malloc((numFree + 1) * sizeof(int));
+  if (weights == NULL || prefix == NULL || cells == NULL || numFree == 0) {
+    free(weights); free(prefix); free(cells);
+    return distributeUniform(grid, gold, 0);
+  }
+
+  /* snapshot the free cells, since placing piles reorders the free set */
+  long total = 0;
+  for (int i = 0; i < numFree; i++) {
+    cells[i] = grid->freeCells[i];
+    total += weights[cells[i]];
+    prefix[i] = total;
+  }
+
+  int placed = 0;
+  int retries = 4 * numPiles;
+  while (placed < numPiles && retries > 0) {
+    long target = ((long)rand() * ((long)RAND_MAX + 1) + rand()) % total;
+
+    /* first cell whose prefix sum exceeds the target */
+    int lo = 0, hi = numFree - 1;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (prefix[mid] > target) {
+        hi = mid;
+      }
+      else {
+        lo = mid + 1;
+      }
+    }
+
+    int cell = cells[lo];
+    if (grid->freeIndex[grid->shared->openIndex[cell]] >= 0) {
+      placePile(grid, gold, placed, cell);
+      placed++;
+    }
+    else {
+      retries--;
+    }
+  }
+
+  free(weights); free(prefix); free(cells);
+  return distributeUniform(grid, gold, placed);
+}
+
+/**
+ * @brief: weighs every cell by 1 + the number of steps needed to walk to it
+ * from the largest room, found by a breadth-first search from every cell
+ * of that room over room floor and passages.
+ * Cells that cannot be reached weigh 1.
+ * The caller must free the returned array (one entry per cell).
+ *
+ * Returns:
+ * @return long*: weights, indexed by cell (y*cols + x), or NULL on error.
+ */
+static long*
+distanceWeights(grid_t* grid)
+{
+  int numCells = grid->rows * grid->cols;
+  long* weights = malloc(numCells * sizeof(long));
+  int* roomSize = calloc(grid->numRooms + 1, sizeof(int));
+  int* queue = malloc(numCells * sizeof(int));
+  if (weights == NULL || roomSize == NULL || queue == NULL) {
+    free(weights); free(roomSize); free(queue);
+    return NULL;
+  }
+
+  /* the largest room is where players most often spawn */
+  int hub = 0;
+  for (int i = 0; i < grid->numOpenCells; i++) {
+    int room = grid->shared->segment[grid->shared->openCells[i]];
+    if (++roomSize[room] > roomSize[hub]) {
+      hub = room;
+    }
+  }
+
+  /* 0 means unvisited; a visited cell weighs 1 + its distance */
+  int head = 0, tail = 0;
+  for (int i = 0; i < numCells; i++) {
+    weights[i] = 0;
+    if (hub != 0 && grid->shared->segment[i] == hub) {
+      weights[i] = 1;
+      queue[tail++] = i;
+    }
+  }
+  while (head < tail) {
+    int cell = queue[head++];
+    int x = cell % grid->cols;
+    int y = cell / grid->cols;
+
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        int nx = x + dx, ny = y + dy;
+        int next = ny * grid->cols + nx;
+        if ((grid_isSpace(grid, nx, ny) || grid_isPassage(grid, nx, ny)
+             || grid_isGold(grid, nx, ny)) && weights[next] == 0) {
+          weights[next] = weights[cell] + 1;
+          queue[tail++] = next;
+        }
+      }
+    }
+  }
+  for (int i = 0; i < numCells; i++) {
+    if (weights[i] == 0) {
+      weights[i] = 1;
+    }
+  }
+
+  free(roomSize); free(queue);
+  return weights;
+}
@@ -20,10 +20,29 @@
 #include "grid.h"       /* grid module */
 #include "player.h"     /* player module */
 
+/**
+ * @brief: policies for scattering gold piles in the map.
+ * GOLD_UNIFORM: every room floor cell is equally likely.
+ * GOLD_BALANCED: piles are dealt round-robin across rooms,
+ * so every room gets the same number of piles, whatever its size.
+ * GOLD_DISTANCE: cells are weighted by how far players must walk
+ * to reach them from the largest room, where most players spawn.
+ */
+typedef enum gold_policy {
+  GOLD_UNIFORM,
+  GOLD_BALANCED,
+  GOLD_DISTANCE
+} gold_policy_t;
+
 typedef struct gold {
-  int* goldCounter;
-  int numPiles;
-  int index;
+  int* goldCounter;     /* nuggets in each pile */
+  int numPiles;         /* number of piles in the game */
+  int numCollected;     /* number of piles picked up so far */
+  int remaining;        /* nuggets not yet picked up */
+  int* pileAt;          /* pile on each room floor cell (as in the map's openCells), or -1;
+                           NULL until distributed */
+  const int* openIndex; /* the map's position of each cell in openCells, or -1 */
+  int cols;             /* width of the map pileAt covers */
 } gold_t;
 
 
@@ -33,11 +52,15 @@ typedef struct gold {
  * 
  * Inputs:
  * @param numPiles: The total desired number of piles of gold to assign.
+ * @param totalGold: The number of nuggets shared out among the piles.
  * 
  * Returns:
  * @return gold_t*: pointer to a struct holding gold information.
+ * @return NULL: numPiles is not positive, or is more than totalGold.
+ * 
+ * NOTE: every pile holds at least one nugget.
  */
-gold_t* gold_init(int numPiles);
+gold_t* gold_init(int numPiles, int totalGold);
 
 
 /**
@@ -57,28 +80,85 @@ void gold_delete(gold_t* gold);
 
 
 /**
- * @brief: function to assign a pile of gold to a given player.
+ * @brief: function to give a player the pile of gold
+ * at a given position, if there is one.
+ * The pile is found by position in constant time,
+ * and the remaining gold is updated.
  * 
  * Inputs: 
  * @param gold: pointer to a gold struct created using gold_init()
+ * and scattered with gold_distribute()
  * @param player: pointer to a player struct 
  * such as the one implemented in player.c and player.h
+ * @param x: the column the player stepped on.
+ * @param y: the row the player stepped on.
  * 
- * Returns: None.
+ * Returns:
+ * @return int: the number of nuggets in the pile,
+ * or 0 if there is no pile at (x, y).
+ * 
+ * NOTE: the caller is responsible for clearing the '*' from the map.
  */
-void gold_assign(gold_t* gold, player_t* player);
+int gold_collect(gold_t* gold, player_t* player, int x, int y);
 
 /**
  * @brief: function to scatter gold in a map,
  * given a map (grid struct) and a gold strict with relevant details.
+ * Piles are drawn without replacement from the map's free room floor
+ * cells, so the time taken is bounded by the number of piles
+ * (plus one pass over the floor cells for the non-uniform policies).
  * 
  * Inputs:
  * @param grid: pointer to a grid struct wherein the map data is stored.
  * @param gold: pointer to gold struct holding information
  * such as the number of piles to scatter in the map.
+ * @param policy: how to choose the cells for the piles.
  * 
  * Returns: None.
+ * 
+ * NOTE: if the map has fewer free cells than gold->numPiles,
+ * only that many piles are placed; the gold of the piles left over
+ * is added to the last placed pile, and gold->numPiles is reduced,
+ * so the total gold in the game does not change.
+ * The gold then reads the grid's shared terrain to find its piles,
+ * so gold_collect() must not be called once the grid is deleted.
+ */
+void gold_distribute(grid_t* grid, gold_t* gold, gold_policy_t policy);
+
+
+/**
+ * @brief: function to parse the name of a gold policy.
+ * 
+ * Inputs:
+ * @param name: "uniform", "balanced" or "distance".
+ * @param policy: filled in with the matching policy.
+ * 
+ * Returns:
+ * @return true: name matched a policy.
+ * @return false: unknown name; policy is unchanged.
+ */
+bool gold_parsePolicy(const char* name, gold_policy_t* policy);
+
+
+/**
+ * @brief: Function to generate a number within a range.
+ * calls rand() to generate a random number 
+ * then bounds it to expectate range using mod operator.
+ * Every random choice of where to put gold or players goes through it,
+ * so that a game depends only on the seed given to srand().
+ * 
+ * Inputs:
+ * @param lower: lower bound, inclusive
+ * @param upper: upper bound, exclusive
+ * 
+ * Returns:
+ * @return int: a random value from lower up to, but not including, upper.
+ * 
+ * NOTE: This function returns -1 as an error flag for invalid bounds.
+ * If called in a context that may result in incorrect bounds, 
+ * The caller may check if the return value is -1
+ * To detect errors. 
  */
-void gold_distribute(grid_t* grid, gold_t* gold);
+int randomInt(int lower, int upper);
 
 #endif /* __GOLD_H */
\ No newline at end of file
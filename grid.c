@@ -3,8 +3,8 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <string.h>
-#include <float.h>
-#include <math.h>
+#include <stdint.h>
+#include <limits.h>
 
 
 #include "file.h"         /* file operations */
@@ -12,55 +12,61 @@
 #include "log.h"
 #include "player.h"       /* player module */
 #include "gamestate.h"    /* gamestate module */
+#include "gold.h"         /* gold module */
 #include "grid.h"         /* self */
 
-static int quadrant(int x1, int y1, int x2, int y2);
+static bool lineOfSight(grid_t* grid, int x1, int y1, int x2, int y2);
+static grid_t* grid_alloc(int rows, int cols, char fill);
+static bool grid_isOwnRow(grid_t* grid, int y);
+static char* readMapFile(FILE* mapfile, size_t* length);
+static grid_t* grid_parseText(const char* text, size_t length);
+static grid_t* grid_parseCompiled(const char* data, size_t length);
+static bool grid_checkCompiled(grid_t* grid);
+static bool grid_preprocess(grid_t* grid);
+static int grid_fillSegment(grid_t* grid, int start, int id, int* queue);
+static bool grid_indexOpenCells(grid_t* grid);
+static bool grid_initFreeCells(grid_t* grid);
+static bool grid_buildGraph(grid_t* grid);
+static void updateView(grid_t* Grid, player_t* player, int minX, int minY, int maxX, int maxY);
+static size_t writeGrid(grid_t* grid, char* out);
+static void writeViewRow(grid_t* grid, grid_view_t* view, int y, int left, int count, char* out);
+static bool view_hasSeen(grid_view_t* view, int cell);
+static int view_findGold(grid_view_t* view, int cell);
+static void view_setGold(grid_view_t* view, int cell, bool gold);
+
+/* characters allowed in a map file */
+static const char* MapCharacters = GRID_TERRAIN;
+
+/* first bytes of a compiled map file */
+static const char CompiledMagic[8] = "NUGMAP1\n";
 
 grid_t* grid_init(FILE* mapfile) {
 
   if (mapfile != NULL) {
-    
-    /* make sure we return to start of file in case of prior reads */
-    rewind(mapfile);
-
-    int rows = file_numLines(mapfile);
-    char* firstLine = file_readLine(mapfile);
-    int cols = strlen(firstLine);
-    free(firstLine);
-
-    /* reset */
-    rewind(mapfile);
-    
-    /* check validity of map */
-    if (rows == 0 || cols == 0) {
+
+    /* read the whole map in one go */
+    size_t length;
+    char* text = readMapFile(mapfile, &length);
+    if (text == NULL) {
+      flog_v(stderr, "Error reading map file. Stop.\n");
       return NULL;
     }
 
-    grid_t* grid  = calloc(1, sizeof(grid_t));
-    if (grid == NULL) {
-      return NULL; 
+    /* compiled maps carry a header; anything else is a text map */
+    grid_t* grid;
+    if (length >= sizeof(CompiledMagic)
+        && memcmp(text, CompiledMagic, sizeof(CompiledMagic)) == 0) {
+      grid = grid_parseCompiled(text, length);
     }
-
-    /* save rows, columns */
-    grid->rows = rows;
-    grid->cols = cols;
-
-    /* create map representation */
-    grid->g = calloc(1, (rows+1) * sizeof(char*));
-
-    /* allocate rows */
-    char** temp = grid->g;
-    for(int i=0; i<rows; i++){
-      temp[i] = malloc(cols+1);
+    else {
+      grid = grid_parseText(text, length);
+      if (grid != NULL && !grid_preprocess(grid)) {
+        grid_delete(grid);
+        grid = NULL;
+      }
     }
 
-    /* copy lines from file as rows */
-    int j = 0;
-    char* line;
-    while( (line = file_readLine(mapfile)) != NULL){
-      strcpy(temp[j++], line);
-			free(line);
-    }
+    free(text);
     /* return grid */
     return grid;
   }
@@ -70,38 +76,233 @@ grid_t* grid_init(FILE* mapfile) {
   return NULL;
 }
 
-grid_t*
-grid_initForPlayer(grid_t* masterGrid)
+bool
+grid_save(grid_t* grid, FILE* fp)
 {
-  if (masterGrid != NULL) {
-    grid_t* grid  = calloc(1, sizeof(grid_t));
-    if (grid == NULL) {
-      return NULL; 
+  if (grid == NULL || fp == NULL || grid->shared->segment == NULL) {
+    flog_v(stderr, "Attempt to save a NULL or unprocessed grid. Stop.\n");
+    return false;
+  }
+
+  int cells = grid->rows * grid->cols;
+
+  /* terrain class of every cell */
+  unsigned char* terrain = malloc(cells);
+  if (terrain == NULL) {
+    return false;
+  }
+  for (int y = 0; y < grid->rows; y++) {
+    for (int x = 0; x < grid->cols; x++) {
+      terrain[y * grid->cols + x] = strchr(MapCharacters, grid->g[y][x]) - MapCharacters;
     }
+  }
 
-    /* save rows, columns */
-    grid->rows = masterGrid->rows;
-    grid->cols = masterGrid->cols;
+  /* header, then the arrays */
+  int header[5] = { grid->rows, grid->cols, grid->numRooms,
+                    grid->numPassages, grid->numOpenCells };
+  bool ok = fwrite(CompiledMagic, sizeof(CompiledMagic), 1, fp) == 1
+         && fwrite(header, sizeof(header), 1, fp) == 1
+         && fwrite(terrain, 1, cells, fp) == cells
+         && fwrite(grid->shared->segment, sizeof(int), cells, fp) == cells
+         && fwrite(grid->shared->openCells, sizeof(int), grid->numOpenCells, fp) == grid->numOpenCells;
+
+  free(terrain);
+  return ok;
+}
 
-    /* create map representation */
-    grid->g = calloc(1, (masterGrid->rows + 1) * sizeof(char*));
+grid_t*
+grid_share(grid_t* grid)
+{
+  if (grid == NULL) {
+    flog_v(stderr, "Error: cannot share a NULL grid. Stop. \n");
+    return NULL;
+  }
 
-    /* allocate rows */
-    for(int i=0; i<masterGrid->rows; i++){
-      grid->g[i] = calloc(1, masterGrid->cols+1);
+  grid_t* copy = calloc(1, sizeof(grid_t));
+  if (copy == NULL) {
+    return NULL;
+  }
+  *copy = *grid;
+
+  /* rows point at the terrain as loaded, until written */
+  copy->g = calloc(grid->rows + 1, sizeof(char*));
+  copy->freeCells = NULL;
+  copy->freeIndex = NULL;
+  if (copy->g == NULL || !grid_initFreeCells(copy)) {
+    free(copy->g);
+    free(copy->freeCells);
+    free(copy->freeIndex);
+    free(copy);
+    return NULL;
+  }
+  for (int y = 0; y < grid->rows; y++) {
+    copy->g[y] = grid->shared->cells + (size_t)y * (grid->cols + 1);
+  }
+  grid->shared->refs++;
+  return copy;
+}
+
+bool
+grid_setCell(grid_t* grid, int x, int y, char c)
+{
+  if (grid == NULL || x < 0 || y < 0 || x >= grid->cols || y >= grid->rows) {
+    return false;
+  }
+  if (grid->g[y][x] == c) {
+    return true;
+  }
+
+  /* copy the row out of the shared terrain on its first change */
+  if (!grid_isOwnRow(grid, y)) {
+    char* row = malloc(grid->cols + 1);
+    if (row == NULL) {
+      flog_v(stderr, "Error allocating memory for a row of the grid.\n");
+      return false;
     }
-    /* fill player grid with spaces as holders */
-    for (int y=0; y<grid->rows; y++) {
-      for (int x=0; x<grid->cols; x++) {
-        grid->g[y][x] = ' ';
+    memcpy(row, grid->g[y], grid->cols + 1);
+    grid->g[y] = row;
+  }
+  grid->g[y][x] = c;
+  return true;
+}
+
+grid_view_t*
+grid_initForPlayer(grid_t* masterGrid)
+{
+  if (masterGrid == NULL) {
+    flog_v(stderr, "Error: cannot init grid to match a NULL grid. Stop. \n");
+    return NULL;
+  }
+
+  /* nothing seen yet; the gold list grows as gold is seen */
+  grid_view_t* view = malloc(sizeof(grid_view_t));
+  if (view == NULL) {
+    return NULL;
+  }
+  view->rows = masterGrid->rows;
+  view->cols = masterGrid->cols;
+  view->seen = calloc(((size_t)view->rows * view->cols + 7) / 8, 1);
+  view->gold = NULL;
+  view->numGold = 0;
+  view->goldCapacity = 0;
+  if (view->seen == NULL) {
+    free(view);
+    return NULL;
+  }
+  return view;
+}
+
+void
+grid_viewCell(grid_t* grid, grid_view_t* view, int x, int y)
+{
+  int cell = y * view->cols + x;
+  view->seen[cell / 8] |= 1 << (cell % 8);
+  view_setGold(view, cell, grid->g[y][x] == '*');
+}
+
+void
+grid_deleteView(grid_view_t* view)
+{
+  if (view != NULL) {
+    free(view->seen);
+    free(view->gold);
+    free(view);
+  }
+}
+
+/**
+ * @brief: finds the bounding box of every segment, and links every room
+ * to the passages that touch its floor (diagonals included), both ways,
+ * as lists of segment ids (compressed rows: one list per segment, in order).
+ *
+ * Returns:
+ * @return true: success.
+ * @return false: out of memory.
+ */
+static bool
+grid_buildGraph(grid_t* grid)
+{
+  int numSegments = grid->numRooms + grid->numPassages;
+  int cells = grid->rows * grid->cols;
+  grid->shared->bounds = malloc(4 * (numSegments + 1) * sizeof(int));
+  grid->shared->linkStart = calloc(numSegments + 2, sizeof(int));
+  int* mark = malloc((numSegments + 1) * sizeof(int));
+  int* pairs = malloc(2 * (cells + 1) * sizeof(int));
+  if (grid->shared->bounds == NULL || grid->shared->linkStart == NULL || mark == NULL || pairs == NULL) {
+    free(mark);
+    free(pairs);
+    return false;
+  }
+
+  /* bounding boxes */
+  for (int s = 0; s <= numSegments; s++) {
+    grid->shared->bounds[4 * s] = grid->cols;
+    grid->shared->bounds[4 * s + 1] = grid->rows;
+    grid->shared->bounds[4 * s + 2] = -1;
+    grid->shared->bounds[4 * s + 3] = -1;
+    mark[s] = -1;
+  }
+  for (int i = 0; i < cells; i++) {
+    int* box = grid->shared->bounds + 4 * grid->shared->segment[i];
+    int x = i % grid->cols, y = i / grid->cols;
+    if (x < box[0]) box[0] = x;
+    if (y < box[1]) box[1] = y;
+    if (x > box[2]) box[2] = x;
+    if (y > box[3]) box[3] = y;
+  }
+
+  /* room-passage pairs, each found once per room by marking */
+  int numPairs = 0;
+  for (int room = 1; room <= grid->numRooms; room++) {
+    int* box = grid->shared->bounds + 4 * room;
+    for (int y = box[1]; y <= box[3]; y++) {
+      for (int x = box[0]; x <= box[2]; x++) {
+        if (grid->shared->segment[y * grid->cols + x] != room) {
+          continue;
+        }
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            int nx = x + dx, ny = y + dy;
+            if (nx < 0 || ny < 0 || nx >= grid->cols || ny >= grid->rows) {
+              continue;
+            }
+            int other = grid->shared->segment[ny * grid->cols + nx];
+            if (other > grid->numRooms && mark[other] != room && numPairs < cells) {
+              mark[other] = room;
+              pairs[2 * numPairs] = room;
+              pairs[2 * numPairs + 1] = other;
+              numPairs++;
+            }
+          }
+        }
       }
     }
+  }
 
-    /* return grid */
-    return grid;
+  /* counting sort the pairs, both ways, into one list per segment */
+  grid->shared->links = malloc((2 * numPairs + 1) * sizeof(int));
+  if (grid->shared->links == NULL) {
+    free(mark);
+    free(pairs);
+    return false;
   }
-  flog_v(stderr, "Error: cannot init grid to match a NULL grid. Stop. \n");
-  return NULL;
+  for (int p = 0; p < numPairs; p++) {
+    grid->shared->linkStart[pairs[2 * p] + 1]++;
+    grid->shared->linkStart[pairs[2 * p + 1] + 1]++;
+  }
+  for (int s = 1; s <= numSegments + 1; s++) {
+    grid->shared->linkStart[s] += grid->shared->linkStart[s - 1];
+    mark[s - 1] = grid->shared->linkStart[s - 1];
+  }
+  for (int p = 0; p < numPairs; p++) {
+    int room = pairs[2 * p], passage = pairs[2 * p + 1];
+    grid->shared->links[mark[room]++] = passage;
+    grid->shared->links[mark[passage]++] = room;
+  }
+
+  free(mark);
+  free(pairs);
+  return true;
 }
 
 /**
@@ -122,7 +323,10 @@ grid_t*
 grid_copy(grid_t* originalGrid)
 {
   // Create pointer to new grid object with correct dimensions
-  grid_t* copy = grid_initForPlayer(originalGrid);
+  grid_t* copy = grid_alloc(originalGrid->rows, originalGrid->cols, ' ');
+  if (copy == NULL) {
+    return NULL;
+  }
 
   // Loop over every line in orig. grid and copy into new grid
   for(int y = 0; y < copy->rows; y++){
@@ -138,38 +342,111 @@ char* grid_toStringForPlayer(gamestate_t* state, player_t* current_player){
   if (state == NULL || current_player == NULL) {
     return NULL;
   }
-  
-  // Get a copy of the master grid
-  grid_t* copy = grid_copy(current_player->grid);
 
-  // Loop through and add player chars for associated points into copy of grid
+  // Render into a buffer of our own
+  grid_t* grid = state->masterGrid;
+  char* stringifiedGrid = malloc((size_t)grid->rows * (grid->cols + 1) + 1);
+  if (stringifiedGrid == NULL) {
+    return NULL;
+  }
+  grid_writeForPlayer(state, current_player, stringifiedGrid);
+  return stringifiedGrid;
+}
+
+size_t
+grid_writeForPlayer(gamestate_t* state, player_t* current_player, char* out)
+{
+  // Write out what the player has seen of the map, row by row
+  grid_t* grid = state->masterGrid;
+  int width = grid->cols + 1;
+  for (int y = 0; y < grid->rows; y++) {
+    writeViewRow(grid, current_player->view, y, 0, grid->cols, out + (size_t)y * width);
+    out[(size_t)y * width + grid->cols] = '\n';
+  }
+  size_t length = (grid->rows > 0) ? (size_t)grid->rows * width - 1 : 0;
+  out[length] = '\0';
+
+  // Loop through and add player chars for associated points into the string
   player_t** allPlayers = state->players;
   for(int i = 0; i < state->players_seen; i++){
     int otherPlayerX = allPlayers[i]->x;
     int otherPlayerY = allPlayers[i]->y;
 
-    if( grid_isPlayerVisible(state, copy, current_player, allPlayers[i]) || allPlayers[i] == current_player){
-			if(!allPlayers[i]->hasQuit && allPlayers[i] != current_player){
-				copy->g[otherPlayerY][otherPlayerX] = allPlayers[i]->letter;
+    if( gamestate_canSee(state, current_player, allPlayers[i]) || allPlayers[i] == current_player){
+			if(player_isActive(allPlayers[i]) && allPlayers[i] != current_player){
+				out[otherPlayerY * width + otherPlayerX] = allPlayers[i]->letter;
 			}
 
 			if(allPlayers[i] == current_player){
-				copy->g[otherPlayerY][otherPlayerX] = '@';
+				out[otherPlayerY * width + otherPlayerX] = '@';
 			}
     }
   }
-  char* stringifiedGrid = calloc(1, ((copy->rows)*sizeof(char*)) * copy->cols);
-  char** map = copy->g;
-  for(int x = 0; x < copy->rows; x++){
-    strcat(stringifiedGrid, map[x]);
-    if (x != copy->rows-1) {
-      strcat(stringifiedGrid, "\n");
+  return length;
+}
+
+char*
+grid_windowForPlayer(gamestate_t* state, player_t* current_player,
+                     int rows, int cols, int* top, int* left)
+{
+  if (state == NULL || current_player == NULL || rows <= 0 || cols <= 0) {
+    return NULL;
+  }
+
+  // Render into a buffer of our own
+  grid_fitWindow(state->masterGrid, current_player, &rows, &cols, top, left);
+  char* window = malloc((size_t)rows * (cols + 1) + 1);
+  if (window == NULL) {
+    return NULL;
+  }
+  grid_writeWindowForPlayer(state, current_player, rows, cols, *top, *left, window);
+  return window;
+}
+
+void
+grid_fitWindow(grid_t* grid, player_t* current_player,
+               int* rows, int* cols, int* top, int* left)
+{
+  // Fit the window in the map, centred on the player
+  *rows = (*rows < grid->rows) ? *rows : grid->rows;
+  *cols = (*cols < grid->cols) ? *cols : grid->cols;
+  *top = current_player->y - *rows / 2;
+  *top = (*top < 0) ? 0 : (*top > grid->rows - *rows) ? grid->rows - *rows : *top;
+  *left = current_player->x - *cols / 2;
+  *left = (*left < 0) ? 0 : (*left > grid->cols - *cols) ? grid->cols - *cols : *left;
+}
+
+size_t
+grid_writeWindowForPlayer(gamestate_t* state, player_t* current_player,
+                          int rows, int cols, int top, int left, char* out)
+{
+  grid_t* grid = state->masterGrid;
+
+  // Write the rows of the window, newline-separated
+  int width = cols + 1;
+  for (int y = 0; y < rows; y++) {
+    writeViewRow(grid, current_player->view, top + y, left, cols, out + y * width);
+    out[y * width + cols] = '\n';
+  }
+  size_t length = (rows > 0) ? (size_t)rows * width - 1 : 0;
+  out[length] = '\0';
+
+  // Add the players in sight, and the player, inside the window
+  player_t** allPlayers = state->players;
+  for (int i = 0; i < state->players_seen; i++) {
+    player_t* other = allPlayers[i];
+    int x = other->x - left;
+    int y = other->y - top;
+    if (x < 0 || y < 0 || x >= cols || y >= rows) {
+      continue;
+    }
+    if (other == current_player) {
+      out[y * width + x] = '@';
+    } else if (player_isActive(other) && gamestate_canSee(state, current_player, other)) {
+      out[y * width + x] = other->letter;
     }
   }
-  // Free copy of grid
-  grid_delete(copy);
-  // Return stringified result
-  return stringifiedGrid;
+  return length;
 }
 
 char*
@@ -178,31 +455,35 @@ grid_toString(gamestate_t* state, grid_t* grid)
   if (state == NULL || grid == NULL) {
     return NULL;
   }
-  // Get a copy of the master grid
-  grid_t* copy = grid_copy(grid);
-  // Loop through and add player chars for associated points into copy of grid
+
+  // Render into a buffer of our own
+  char* stringifiedGrid = malloc((size_t)grid->rows * (grid->cols + 1) + 1);
+  if (stringifiedGrid == NULL) {
+    return NULL;
+  }
+  grid_write(state, grid, stringifiedGrid);
+  return stringifiedGrid;
+}
+
+size_t
+grid_write(gamestate_t* state, grid_t* grid, char* out)
+{
+  // Write out the grid
+  size_t length = writeGrid(grid, out);
+  int width = grid->cols + 1;
+
+  // Loop through and add player chars for associated points into the string
   player_t** allPlayers = state->players;
   for(int i = 0; i < state->players_seen; i++){
-    // Update copy of grid with player letters
+    // Update string with player letters
     int currentPlayerX = allPlayers[i]->x;
     int currentPlayerY = allPlayers[i]->y;
 
-		if(!allPlayers[i]->hasQuit){
-			copy->g[currentPlayerY][currentPlayerX] = allPlayers[i]->letter;
+		if(player_isActive(allPlayers[i])){
+			out[currentPlayerY * width + currentPlayerX] = allPlayers[i]->letter;
 		}
   }
-  char* stringifiedGrid = calloc(1, ((copy->rows)*sizeof(char*)) * copy->cols);
-  char** map = copy->g;
-  for(int x = 0; x < copy->rows; x++){
-    strcat(stringifiedGrid, map[x]);
-    if (x != copy->rows-1) {
-      strcat(stringifiedGrid, "\n");
-    }
-  }
-  // Free copy of grid
-  grid_delete(copy);
-  // Return stringified result
-  return stringifiedGrid;
+  return length;
 }
 
 char* 
@@ -212,14 +493,14 @@ grid_masterGridToString(grid_t* grid, gamestate_t* gamestate)
   int cols = grid_getColumns(grid);
 
   player_t** players = gamestate_getPlayers(gamestate);
-  for (int i = 0; i<25; i++) {
+  for (int i = 0; i < gamestate->players_seen; i++) {
     if (players[i] != NULL) {
       int x = player_getX(players[i]);
       int y = player_getY(players[i]);
       char letter = player_getLetter(players[i]);
       int pos = cols*(y) + y + x;            /* (length of previous cols) + ("\n" ) + pos in current row */ 
 
-			if(!players[i]->hasQuit){
+			if(player_isActive(players[i])){
 				map[pos] = letter;
 			}
     }
@@ -294,559 +575,380 @@ grid_isSpace(grid_t* grid, int x, int y) {
   return master[y][x] == '.';
 }
 
-bool
-grid_isRoomSpot(grid_t* grid, int x, int y){
-	if(x < 0 || y < 0|| x >= grid->cols || y >= grid->rows){
-    	return false;
-  	}
-	if(grid_isWall(grid, x, y) || grid_isPassage(grid, x, y)){
-		return false;
-	}
-	return true;
+void
+grid_claimCell(grid_t* grid, int x, int y)
+{
+  if (grid == NULL || grid->freeIndex == NULL
+      || x < 0 || y < 0 || x >= grid->cols || y >= grid->rows) {
+    return;
+  }
+
+  int open = grid->shared->openIndex[y * grid->cols + x];
+  if (open < 0) {
+    return;     /* not room floor */
+  }
+  int pos = grid->freeIndex[open];
+  if (pos >= 0) {
+    /* move the last free cell into the hole */
+    int last = grid->freeCells[--grid->numFreeCells];
+    grid->freeCells[pos] = last;
+    grid->freeIndex[grid->shared->openIndex[last]] = pos;
+    grid->freeIndex[open] = -1;
+  }
 }
 
-static double calculate_slope(int x1, int y1, int x2, int y2){
+void
+grid_releaseCell(grid_t* grid, int x, int y)
+{
+  /* only cells that were room floor when the map was loaded,
+     which the free list was sized for, may enter it */
+  if (grid == NULL || grid->freeIndex == NULL
+      || grid_roomAt(grid, x, y) == 0 || grid_isGold(grid, x, y)) {
+    return;
+  }
 
-    if(y1 == y2){
-        return DBL_MAX;
-    }
+  int cell = y * grid->cols + x;
+  int open = grid->shared->openIndex[cell];
+  if (grid->freeIndex[open] < 0) {
+    grid->freeIndex[open] = grid->numFreeCells;
+    grid->freeCells[grid->numFreeCells++] = cell;
+  }
+}
+
+bool
+grid_randomFreeCell(grid_t* grid, int* x, int* y)
+{
+  if (grid == NULL || grid->freeCells == NULL || grid->numFreeCells == 0) {
+    return false;
+  }
 
-    return ((double)(x1 - x2))/((double)(y1 - y2));
+  int cell = grid->freeCells[randomInt(0, grid->numFreeCells)];
+  *x = cell % grid->cols;
+  *y = cell / grid->cols;
+  return true;
 }
 
-static int quadrant(int x1, int y1, int x2, int y2){
-	if(x1 < x2 && y1 < y2){
-		return 1;
-	}else if(x1 > x2 && y1 < y2){
-		return 3;
-	}else if(x1 < x2 && y1 > y2){
-		return 2;
-	}else{
-		return 4;
-	}
+int
+grid_segmentAt(grid_t* grid, int x, int y)
+{
+  if (grid == NULL || grid->shared->segment == NULL
+      || x < 0 || y < 0 || x >= grid->cols || y >= grid->rows) {
+    return 0;
+  }
+  return grid->shared->segment[y * grid->cols + x];
 }
 
+int
+grid_roomAt(grid_t* grid, int x, int y)
+{
+  int segment = grid_segmentAt(grid, x, y);
+  return (segment <= grid->numRooms) ? segment : 0;
+}
 
-void grid_calculateVisibility(grid_t* Grid, player_t* player){
-    char **master_grid = Grid->g;
-    char **player_grid = player->grid->g;
-    double slope;
-    double x_pred, y_pred;
-    int upper, lower;
-    bool visibility;
-
-	for(int y = 0; y < Grid->rows; y++){
-    	for(int x = 0; x < Grid->cols; x++){
-			if(master_grid[y][x] == ' '){
-				continue;
-			}
-			
-			bool equality = false;
-			if(player->y == y){
-				int x1 = player->x;
-				while(grid_isRoomSpot(Grid, x1, player->y)){
-					player_grid[player->y][x1] = master_grid[player->y][x1];
-					x1 += 1;
-				}
-				player_grid[player->y][x1] = master_grid[player->y][x1];
-				x1 = player->x;
-				while(grid_isRoomSpot(Grid, x1, player->y)){
-					player_grid[player->y][x1] = master_grid[player->y][x1];
-					x1 -= 1;
-				}
-				player_grid[player->y][x1] = master_grid[player->y][x1];
-				if(player->x == x){
-					int y1 = player->y;
-					while(grid_isRoomSpot(Grid, player->x, y1)){
-						player_grid[y1][player->x] = master_grid[y1][player->x];
-						y1 += 1;
-					}
-					player_grid[y1][player->x] = master_grid[y1][player->x];
-					y1 = player->y;
-					while(grid_isRoomSpot(Grid, player->x, y1)){
-						player_grid[y1][player->x] = master_grid[y1][player->x];
-						y1 -= 1;
-					}
-					player_grid[y1][player->x] = master_grid[y1][player->x];
-				}
-				equality = true;
-			}
-			if(player->x == x){
-				int y1 = player->y;
-				while(grid_isRoomSpot(Grid, player->x, y1)){
-					player_grid[y1][player->x] = master_grid[y1][player->x];
-					y1 += 1;
-				}
-				player_grid[y1][player->x] = master_grid[y1][player->x];
-				y1 = player->y;
-				while(grid_isRoomSpot(Grid, player->x, y1)){
-					player_grid[y1][player->x] = master_grid[y1][player->x];
-					y1 -= 1;
-				}
-				player_grid[y1][player->x] = master_grid[y1][player->x];
-				if(player->y == y){
-					int x1 = player->x;
-					while(grid_isRoomSpot(Grid, x1, player->y)){
-						player_grid[player->y][x1] = master_grid[player->y][x1];
-						x1 += 1;
-					}
-					player_grid[player->y][x1] = master_grid[player->y][x1];
-					x1 = player->x;
-					while(grid_isRoomSpot(Grid, x1, player->y)){
-						player_grid[player->y][x1] = master_grid[player->y][x1];
-						x1 -= 1;
-					}
-					player_grid[player->y][x1] = master_grid[player->y][x1];
-				}
-				equality = true;
-			}
+const int*
+grid_getLinks(grid_t* grid, int segment, int* count)
+{
+  *count = 0;
+  if (grid == NULL || grid->shared->linkStart == NULL
+      || segment < 1 || segment > grid->numRooms + grid->numPassages) {
+    return NULL;
+  }
+  *count = grid->shared->linkStart[segment + 1] - grid->shared->linkStart[segment];
+  return (*count > 0) ? grid->shared->links + grid->shared->linkStart[segment] : NULL;
+}
 
-			if(grid_isGold(Grid, x, y) && player_grid[y][x] != ' '){
-				player_grid[y][x] = '.';
-			}
+void grid_calculateVisibility(grid_t* Grid, player_t* player){
+	int room = grid_roomAt(Grid, player->x, player->y);
 
-			if(equality){
-				continue;
-			}
+	// Forget the gold of the room last seen, if we have left it
+	if(player->viewRoom != 0 && player->viewRoom != room && Grid->shared->bounds != NULL){
+		int* box = Grid->shared->bounds + 4 * player->viewRoom;
+		updateView(Grid, player, box[0] - 1, box[1] - 1, box[2] + 1, box[3] + 1);
+	}
 
-			visibility = true;
-			int quad = quadrant(x, y, player->x, player->y);
-			if(quad == 1 || quad == 2){
-				if(quad == 1){
-					slope = calculate_slope(player->x, player->y, x, y);
-					for(int y1 = 0; y1 < player->y - y; y1++){
-						x_pred = y1 * slope;
-						double x_new = player->x - x_pred;
-						int y_new = player->y - y1;
-						upper = (int)ceil(x_new);
-						lower = (int)floor(x_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, upper, y_new)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-					slope = 1/slope;
-					for(int x1 = 0; x1 < player->x - x; x1++){
-						y_pred = x1 * slope;
-						int x_new = player->x - x1;
-						double y_new = player->y - y_pred;
-						upper = (int)ceil(y_new);
-						lower = (int)floor(y_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, x_new, upper)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-				}else{
-					slope = calculate_slope(player->x, player->y, x, y);
-					for(int y1 = 0; y1 < y - player->y; y1++){
-						x_pred = y1 * slope;
-						double x_new = player->x + x_pred;
-						int y_new = player->y + y1;
-						upper = (int)ceil(x_new);
-						lower = (int)floor(x_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, upper, y_new)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-					slope = 1/slope;
-					for(int x1 = 0; x1 < player->x - x; x1++){
-						y_pred = x1 * slope;
-						int x_new = player->x - x1;
-						double y_new = player->y - y_pred;
-						upper = (int)ceil(y_new);
-						lower = (int)floor(y_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, x_new, upper)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-				}
-				
-			}
-			if(quad == 3 || quad == 4){
-				
-				if(quad == 3){
-					slope = calculate_slope(player->x, player->y, x, y);
-					for(int y1 = 0; y1 < player->y - y; y1++){
-						x_pred = y1 * slope;
-						double x_new = player->x - x_pred;
-						int y_new = player->y - y1;
-						upper = (int)ceil(x_new);
-						lower = (int)floor(x_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, upper, y_new)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-					slope = 1/slope;
-					for(int x1 = 0; x1 < x - player->x; x1++){
-						y_pred = x1 * slope;
-						int x_new = player->x + x1;
-						double y_new = player->y + y_pred;
-						upper = (int)ceil(y_new);
-						lower = (int)floor(y_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, x_new, upper)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-				}else{
-					slope = calculate_slope(player->x, player->y, x, y);
-					for(int y1 = 0; y1 < y - player->y; y1++){
-						x_pred = y1 * slope;
-						double x_new = player->x + x_pred;
-						int y_new = player->y + y1;
-						upper = (int)ceil(x_new);
-						lower = (int)floor(x_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, upper, y_new)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-					slope = 1/slope;
-					for(int x1 = 0; x1 < x - player->x; x1++){
-						y_pred = x1 * slope;
-						int x_new = player->x + x1;
-						double y_new = player->y + y_pred;
-						upper = (int)ceil(y_new);
-						lower = (int)floor(y_new);
-						if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-							if(upper == lower){
-								if(!grid_isRoomSpot(Grid, x_new, upper)){
-									visibility = false;
-									break;
-								}
-							}else{
-								if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-									visibility = false;
-									break;
-								}
-							}
-						}
-					}
-				}
-			}
-			if(visibility){
-				player_grid[y][x] = master_grid[y][x];
-				if(grid_isGold(Grid, x, y)){
-					player_grid[y][x] = '*';
-				}
-			}else{
-				if(grid_isGold(Grid, x, y) && player_grid[y][x] != ' '){
-					player_grid[y][x] = '.';
+	// Everything visible lies within the room and its walls
+	if(room != 0 && Grid->shared->bounds != NULL){
+		int* box = Grid->shared->bounds + 4 * room;
+		updateView(Grid, player, box[0] - 1, box[1] - 1, box[2] + 1, box[3] + 1);
+	}else if(room != 0){
+		updateView(Grid, player, 0, 0, Grid->cols - 1, Grid->rows - 1);
+	}else{
+		// From a passage, only its own cells next to the player are in sight
+		updateView(Grid, player, player->x, player->y, player->x, player->y);
+		for(int dy = -1; dy <= 1; dy++){
+			for(int dx = -1; dx <= 1; dx++){
+				if(grid_isPassage(Grid, player->x + dx, player->y + dy)){
+					grid_viewCell(Grid, player->view, player->x + dx, player->y + dy);
 				}
 			}
-        }
-    }
-
+		}
+	}
+	player->viewRoom = room;
 }
 
 bool grid_isPlayerVisible(gamestate_t* state, grid_t* Grid, player_t* player, player_t* player2){
-    double slope;
-    double x_pred, y_pred;
-    int upper, lower;
-	int x = player2->x;
-	int y = player2->y;
-
+	// Players in passages see, and are seen, only next to each other
 	if(grid_isPassage(state->masterGrid, player->x, player->y) || grid_isPassage(state->masterGrid, player2->x, player2->y)){
-		return false;
+		return grid_isPassage(state->masterGrid, player->x, player->y)
+		       && grid_isPassage(state->masterGrid, player2->x, player2->y)
+		       && abs(player->x - player2->x) <= 1 && abs(player->y - player2->y) <= 1;
 	}
+	// A player sees itself; no two players share a cell
+	if(player->x == player2->x && player->y == player2->y){
+		return player == player2;
+	}
+	return lineOfSight(Grid, player->x, player->y, player2->x, player2->y);
+}
 
-	if(player->y == y){
-		if(player->x < x){
-			int x1 = player->x;
-			x1 += 1;
-			while(grid_isRoomSpot(Grid, x1, player->y)){
-				if(x == x1 && y == player->y){
-					return true;
-				}
-				x1 += 1;
+/**
+ * @brief: updates a player's view of the cells in a box
+ * (clipped to the map): cells in sight are copied from the master grid;
+ * gold out of sight is forgotten, as it may be taken meanwhile.
+ */
+static void
+updateView(grid_t* Grid, player_t* player, int minX, int minY, int maxX, int maxY)
+{
+	char **master_grid = Grid->g;
+	grid_view_t* view = player->view;
+
+	minX = (minX < 0) ? 0 : minX;
+	minY = (minY < 0) ? 0 : minY;
+	maxX = (maxX >= Grid->cols) ? Grid->cols - 1 : maxX;
+	maxY = (maxY >= Grid->rows) ? Grid->rows - 1 : maxY;
+
+	for(int y = minY; y <= maxY; y++){
+		for(int x = minX; x <= maxX; x++){
+			if(master_grid[y][x] == ' '){
+				continue;
 			}
-		}else{
-			int x1 = player->x;
-			x1 -= 1;
-			while(grid_isRoomSpot(Grid, x1, player->y)){
-				if(x == x1 && y == player->y){
-					return true;
+
+			int cell = y * view->cols + x;
+			if(lineOfSight(Grid, player->x, player->y, x, y)){
+				view->seen[cell / 8] |= 1 << (cell % 8);
+				if(master_grid[y][x] == '*'){
+					view_setGold(view, cell, true);
 				}
-				x1 -= 1;
+			}else if(master_grid[y][x] == '*'){
+				// Remembered gold may have been taken since
+				view_setGold(view, cell, false);
 			}
 		}
 	}
-	if(player->x == x){
-		if(player->y < y){
-			int y1 = player->y;
-			y1 += 1;
-			while(grid_isRoomSpot(Grid, player->x, y1)){
-				if(player->x == x && y == y1){
-					return true;
+
+	// Remembered gold in sight that is no longer there
+	for(int g = view->numGold - 1; g >= 0; g--){
+		int x = view->gold[g] % view->cols;
+		int y = view->gold[g] / view->cols;
+		if(x >= minX && x <= maxX && y >= minY && y <= maxY && master_grid[y][x] != '*'
+		   && lineOfSight(Grid, player->x, player->y, x, y)){
+			view->gold[g] = view->gold[--view->numGold];
+		}
+	}
+}
+
+/**
+ * @brief: writes count cells of row y of a player's view, from column
+ * left: blank where unseen, else the terrain of the master grid,
+ * with gold where the player last saw gold.
+ */
+static void
+writeViewRow(grid_t* grid, grid_view_t* view, int y, int left, int count, char* out)
+{
+	const char* row = grid->g[y] + left;
+	int cell = y * view->cols + left;
+	int i = 0;
+	while (i < count) {
+		// Sixty-four cells at a time, then eight, where all are seen or none is
+		if (cell % 64 == 0 && i + 64 <= count) {
+			uint64_t bits;
+			memcpy(&bits, view->seen + cell / 8, sizeof(bits));
+			if (bits == 0 || bits == UINT64_MAX) {
+				if (bits == 0) {
+					memset(out + i, ' ', 64);
+				} else {
+					memcpy(out + i, row + i, 64);
 				}
-				y1 += 1;
+				i += 64;
+				cell += 64;
+				continue;
 			}
-		}else{
-			int y1 = player->y;
-			y1 -= 1;
-			while(grid_isRoomSpot(Grid, player->x, y1)){
-				if(player->x == x && y == y1){
-					return true;
+		}
+		if (cell % 8 == 0 && i + 8 <= count) {
+			unsigned char bits = view->seen[cell / 8];
+			if (bits == 0 || bits == 0xff) {
+				if (bits == 0) {
+					memset(out + i, ' ', 8);
+				} else {
+					memcpy(out + i, row + i, 8);
 				}
-				y1 -= 1;
+				i += 8;
+				cell += 8;
+				continue;
 			}
 		}
+		out[i] = view_hasSeen(view, cell) ? row[i] : ' ';
+		i++;
+		cell++;
 	}
 
-	if(player->x == x || player->y == y){
-		return false;
+	// Gold lies on room floor, and shows only where remembered
+	char* gold = out;
+	while ((gold = memchr(gold, '*', count - (gold - out))) != NULL) {
+		*gold++ = '.';
+	}
+	// Gold the player remembers, within the row
+	for (int g = 0; g < view->numGold; g++) {
+		int x = view->gold[g] % view->cols;
+		if (view->gold[g] / view->cols == y && x >= left && x < left + count) {
+			out[x - left] = '*';
+		}
 	}
+}
 
-	int quad = quadrant(x, y, player->x, player->y);
-	if(quad == 1 || quad == 2){
-		if(quad == 1){
-			slope = calculate_slope(player->x, player->y, x, y);
-			for(int y1 = 0; y1 < player->y - y; y1++){
-				x_pred = y1 * slope;
-				double x_new = player->x - x_pred;
-				int y_new = player->y - y1;
-				upper = (int)ceil(x_new);
-				lower = (int)floor(x_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, upper, y_new)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-							return false;
-						}
-					}
-				}
-			}
-			slope = 1/slope;
-			for(int x1 = 0; x1 < player->x - x; x1++){
-				y_pred = x1 * slope;
-				int x_new = player->x - x1;
-				double y_new = player->y - y_pred;
-				upper = (int)ceil(y_new);
-				lower = (int)floor(y_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, x_new, upper)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-							return false;
-						}
-					}
-				}
-			}
-		}else{
-			slope = calculate_slope(player->x, player->y, x, y);
-			for(int y1 = 0; y1 < y - player->y; y1++){
-				x_pred = y1 * slope;
-				double x_new = player->x + x_pred;
-				int y_new = player->y + y1;
-				upper = (int)ceil(x_new);
-				lower = (int)floor(x_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, upper, y_new)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-							return false;
-						}
-					}
-				}
-			}
-			slope = 1/slope;
-			for(int x1 = 0; x1 < player->x - x; x1++){
-				y_pred = x1 * slope;
-				int x_new = player->x - x1;
-				double y_new = player->y - y_pred;
-				upper = (int)ceil(y_new);
-				lower = (int)floor(y_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, x_new, upper)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-							return false;
-						}
-					}
-				}
-			}
+/**
+ * @brief: whether a player has seen a cell (y*cols + x).
+ */
+static bool
+view_hasSeen(grid_view_t* view, int cell)
+{
+	return (view->seen[cell / 8] >> (cell % 8)) & 1;
+}
+
+/**
+ * @brief: where a cell is in a view's list of gold, or -1.
+ */
+static int
+view_findGold(grid_view_t* view, int cell)
+{
+	for (int g = 0; g < view->numGold; g++) {
+		if (view->gold[g] == cell) {
+			return g;
 		}
-		
 	}
-	if(quad == 3 || quad == 4){
-		
-		if(quad == 3){
-			slope = calculate_slope(player->x, player->y, x, y);
-			for(int y1 = 0; y1 < player->y - y; y1++){
-				x_pred = y1 * slope;
-				double x_new = player->x - x_pred;
-				int y_new = player->y - y1;
-				upper = (int)ceil(x_new);
-				lower = (int)floor(x_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, upper, y_new)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-							return false;
-						}
-					}
-				}
-			}
-			slope = 1/slope;
-			for(int x1 = 0; x1 < x - player->x; x1++){
-				y_pred = x1 * slope;
-				int x_new = player->x + x1;
-				double y_new = player->y + y_pred;
-				upper = (int)ceil(y_new);
-				lower = (int)floor(y_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, x_new, upper)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-							return false;
-						}
-					}
-				}
-			}
-		}else{
-			slope = calculate_slope(player->x, player->y, x, y);
-			for(int y1 = 0; y1 < y - player->y; y1++){
-				x_pred = y1 * slope;
-				double x_new = player->x + x_pred;
-				int y_new = player->y + y1;
-				upper = (int)ceil(x_new);
-				lower = (int)floor(x_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->cols && lower < Grid->cols){
-
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, upper, y_new)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, upper, y_new) && !grid_isRoomSpot(Grid, lower, y_new)){
-							return false;
-						}
-					}
-				}
-			}
-			slope = 1/slope;
-			for(int x1 = 0; x1 < x - player->x; x1++){
-				y_pred = x1 * slope;
-				int x_new = player->x + x1;
-				double y_new = player->y + y_pred;
-				upper = (int)ceil(y_new);
-				lower = (int)floor(y_new);
-				if(upper >= 0 && lower >= 0 && upper < Grid->rows && lower < Grid->rows){
-					if(upper == lower){
-						if(!grid_isRoomSpot(Grid, x_new, upper)){
-							return false;
-						}
-					}else{
-						if(!grid_isRoomSpot(Grid, x_new, upper) && !grid_isRoomSpot(Grid, x_new, lower)){
-							return false;
-						}
-					}
-				}
+	return -1;
+}
+
+/**
+ * @brief: remembers, or forgets, gold at a cell of a view.
+ * If memory runs out, the gold is not remembered.
+ */
+static void
+view_setGold(grid_view_t* view, int cell, bool gold)
+{
+	int g = view_findGold(view, cell);
+	if (!gold && g >= 0) {
+		view->gold[g] = view->gold[--view->numGold];
+	} else if (gold && g < 0) {
+		if (view->numGold == view->goldCapacity) {
+			int capacity = (view->goldCapacity > 0) ? 2 * view->goldCapacity : 8;
+			int* grown = realloc(view->gold, capacity * sizeof(int));
+			if (grown == NULL) {
+				return;
 			}
+			view->gold = grown;
+			view->goldCapacity = capacity;
+		}
+		view->gold[view->numGold++] = cell;
+	}
+}
+
+/**
+ * @brief: writes a grid out as text, one line per row,
+ * with newlines between rows, in one pass over the cells.
+ *
+ * Inputs:
+ * @param out: room for rows * (cols + 1) + 1 bytes.
+ *
+ * Returns:
+ * @return size_t: the length of the text, rows * (cols + 1) - 1 bytes
+ * (and a '\0'); the cell at (x, y) is at y * (cols + 1) + x.
+ */
+static size_t
+writeGrid(grid_t* grid, char* out)
+{
+  int width = grid->cols + 1;
+  for (int y = 0; y < grid->rows; y++) {
+    memcpy(out + (size_t)y * width, grid->g[y], grid->cols);
+    out[(size_t)y * width + grid->cols] = '\n';
+  }
+  /* no newline after the last row */
+  size_t length = (grid->rows > 0) ? (size_t)grid->rows * width - 1 : 0;
+  out[length] = '\0';
+  return length;
+}
+
+/**
+ * @brief: the line-of-sight rule, in integer arithmetic.
+ * Walk the straight line from (x1, y1) towards (x2, y2), stopping
+ * short of (x2, y2), once per row it crosses and once per column.
+ * Where the line passes exactly through a cell, that cell must be
+ * room floor; where it passes between two cells, either of them
+ * must be. Floor is judged by the map as loaded, so a player standing
+ * in a passage does not make it see-through. (x2, y2) itself is visible if no step is blocked, so the
+ * first wall in any direction is seen but not what lies beyond it.
+ * Offsets along the line are kept as whole numbers scaled by the
+ * length of the other axis, so there is no rounding.
+ *
+ * Returns:
+ * @return true: (x2, y2) can be seen from (x1, y1).
+ * @return false: the line is blocked.
+ */
+static bool
+lineOfSight(grid_t* grid, int x1, int y1, int x2, int y2)
+{
+	int dx = x2 - x1, dy = y2 - y1;
+	int sx = (dx > 0) - (dx < 0), sy = (dy > 0) - (dy < 0);
+	int adx = dx * sx, ady = dy * sy;
+
+	// One step per row: the line is at x1 + sx * (k * adx / ady)
+	for(int k = 0, n = 0; k < ady; k++, n += adx){
+		int q = n / ady;
+		int y = y1 + sy * k;
+		int x = x1 + sx * q;
+		if(grid_roomAt(grid, x, y) == 0
+		   && (n % ady == 0 || grid_roomAt(grid, x + sx, y) == 0)){
+			return false;
+		}
+	}
+
+	// One step per column: the line is at y1 + sy * (k * ady / adx)
+	for(int k = 0, n = 0; k < adx; k++, n += ady){
+		int q = n / adx;
+		int x = x1 + sx * k;
+		int y = y1 + sy * q;
+		if(grid_roomAt(grid, x, y) == 0
+		   && (n % adx == 0 || grid_roomAt(grid, x, y + sy) == 0)){
+			return false;
 		}
 	}
+
 	return true;
 }
 
 void
 grid_delete(grid_t* grid) {
   if (grid != NULL) {
-    for (int y=0; y<grid->rows; y++) {
-      free(grid->g[y]);
+    /* our own gold and players */
+    free(grid->freeCells);
+    free(grid->freeIndex);
+    for (int y = 0; y < grid->rows; y++) {
+      if (grid_isOwnRow(grid, y)) {
+        free(grid->g[y]);
+      }
     }
     free(grid->g);
+
+    /* the terrain, once no other grid uses it */
+    if (--grid->shared->refs == 0) {
+      free(grid->shared->segment);
+      free(grid->shared->openCells);
+      free(grid->shared->openIndex);
+      free(grid->shared->bounds);
+      free(grid->shared->linkStart);
+      free(grid->shared->links);
+      free(grid->shared->cells);
+      free(grid->shared);
+    }
     free(grid);
   }
 }
@@ -880,3 +982,415 @@ grid_getGrid(grid_t* grid)
   flog_v(stderr, "Attempt to get grid representation in a NULL grid. Stop.\n");
   return NULL;
 }
+
+
+/**************** Static Functions ******************/
+
+/**
+ * @brief: allocates a grid of the given size, every cell set to fill.
+ * The rows are stored back to back in a single block, the grid's
+ * shared cells, each terminated by a null, with g[y] pointing at row y.
+ * The caller must later free the grid by calling grid_delete().
+ *
+ * Returns:
+ * @return grid_t*: the new grid, or NULL if memory could not be allocated.
+ */
+static grid_t*
+grid_alloc(int rows, int cols, char fill)
+{
+  grid_t* grid = calloc(1, sizeof(grid_t));
+  if (grid == NULL) {
+    return NULL;
+  }
+
+  /* save rows, columns */
+  grid->rows = rows;
+  grid->cols = cols;
+
+  /* row pointers, NULL-terminated, and one block for the cells,
+     written while the map loads, then shared */
+  grid->g = calloc(rows + 1, sizeof(char*));
+  grid->shared = calloc(1, sizeof(grid_shared_t));
+  char* cells = malloc((size_t)rows * (cols + 1));
+  if (grid->g == NULL || grid->shared == NULL || cells == NULL) {
+    free(grid->g);
+    free(grid->shared);
+    free(cells);
+    free(grid);
+    return NULL;
+  }
+  grid->shared->refs = 1;
+  grid->shared->cells = cells;
+
+  memset(cells, fill, (size_t)rows * (cols + 1));
+  for (int y = 0; y < rows; y++) {
+    grid->g[y] = cells + (size_t)y * (cols + 1);
+    grid->g[y][cols] = '\0';
+  }
+  return grid;
+}
+
+/**
+ * @brief: builds a grid from the text of a map file, in one pass
+ * to find dimensions and validate, and one to copy the cells:
+ * rows are lines, cols is the longest line,
+ * ignoring the '\r' of DOS line endings.
+ *
+ * Returns:
+ * @return grid_t*: the new grid, not yet preprocessed,
+ * or NULL if the map is empty or holds invalid characters.
+ */
+static grid_t*
+grid_parseText(const char* text, size_t length)
+{
+  int rows = 0, cols = 0, width = 0;
+  for (size_t i = 0; i < length; i++) {
+    char c = text[i];
+    if (c == '\n') {
+      rows++;
+      width = 0;
+    }
+    else if (c == '\r' && (i + 1 == length || text[i + 1] == '\n')) {
+      continue;
+    }
+    else if (c != '\0' && strchr(MapCharacters, c) != NULL) {
+      if (++width > cols) {
+        cols = width;
+      }
+    }
+    else {
+      flog_c(stderr, "Invalid character '%c' in map file. Stop.\n", c);
+      return NULL;
+    }
+  }
+  /* count a last line with no newline */
+  if (length > 0 && text[length - 1] != '\n') {
+    rows++;
+  }
+
+  /* check validity of map */
+  if (rows == 0 || cols == 0) {
+    return NULL;
+  }
+
+  /* allocate the grid, padded with solid rock for short lines */
+  grid_t* grid = grid_alloc(rows, cols, ' ');
+  if (grid == NULL) {
+    return NULL;
+  }
+
+  /* copy lines from file as rows */
+  int y = 0, x = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] == '\n') {
+      y++;
+      x = 0;
+    }
+    else if (text[i] != '\r') {
+      grid->g[y][x++] = text[i];
+    }
+  }
+  return grid;
+}
+
+/**
+ * @brief: builds a grid from a compiled map written by grid_save().
+ * Sizes and terrain classes are checked against the data,
+ * but segments and floor cells are trusted, as mapc produced them.
+ *
+ * Returns:
+ * @return grid_t*: the new grid, already preprocessed,
+ * or NULL if the data is truncated or corrupt.
+ */
+static grid_t*
+grid_parseCompiled(const char* data, size_t length)
+{
+  int header[5];
+  size_t offset = sizeof(CompiledMagic);
+  if (length < offset + sizeof(header)) {
+    flog_v(stderr, "Truncated compiled map. Stop.\n");
+    return NULL;
+  }
+  memcpy(header, data + offset, sizeof(header));
+  offset += sizeof(header);
+
+  int rows = header[0], cols = header[1], numOpenCells = header[4];
+  int numRooms = header[2], numPassages = header[3];
+  size_t cells = (rows > 0 && cols > 0) ? (size_t)rows * cols : 0;
+  /* every segment and floor cell is a cell; cell indices must fit an int */
+  if (cells == 0 || cells > INT_MAX / 4 || numRooms < 0 || numPassages < 0
+      || (size_t)numRooms + numPassages > cells
+      || numOpenCells < 0 || (size_t)numOpenCells > cells) {
+    flog_v(stderr, "Corrupt compiled map header. Stop.\n");
+    return NULL;
+  }
+  if (length != offset + cells + cells * sizeof(int) + numOpenCells * sizeof(int)) {
+    flog_v(stderr, "Compiled map size does not match its header. Stop.\n");
+    return NULL;
+  }
+
+  grid_t* grid = grid_alloc(rows, cols, ' ');
+  if (grid == NULL) {
+    return NULL;
+  }
+  grid->numRooms = numRooms;
+  grid->numPassages = numPassages;
+  grid->numOpenCells = numOpenCells;
+  grid->shared->segment = malloc(cells * sizeof(int));
+  grid->shared->openCells = malloc((numOpenCells + 1) * sizeof(int));
+  if (grid->shared->segment == NULL || grid->shared->openCells == NULL) {
+    grid_delete(grid);
+    return NULL;
+  }
+
+  /* terrain classes back to map characters */
+  for (size_t i = 0; i < cells; i++) {
+    unsigned char terrain = data[offset + i];
+    if (terrain >= strlen(MapCharacters)) {
+      flog_v(stderr, "Invalid terrain class in compiled map. Stop.\n");
+      grid_delete(grid);
+      return NULL;
+    }
+    grid->g[i / cols][i % cols] = MapCharacters[terrain];
+  }
+  offset += cells;
+
+  memcpy(grid->shared->segment, data + offset, cells * sizeof(int));
+  offset += cells * sizeof(int);
+  memcpy(grid->shared->openCells, data + offset, numOpenCells * sizeof(int));
+
+  if (!grid_checkCompiled(grid)) {
+    flog_v(stderr, "Corrupt compiled map segments or floor cells. Stop.\n");
+    grid_delete(grid);
+    return NULL;
+  }
+  if (!grid_indexOpenCells(grid) || !grid_initFreeCells(grid) || !grid_buildGraph(grid)) {
+    grid_delete(grid);
+    return NULL;
+  }
+  return grid;
+}
+
+/**
+ * @brief: checks the segments and floor cells read from a compiled map,
+ * which are used as indices: every cell's segment must be 0 or a room
+ * or passage id, and every floor cell must be a distinct '.' cell.
+ *
+ * Returns:
+ * @return true: the grid is safe to index with them.
+ * @return false: the map is corrupt, or out of memory.
+ */
+static bool
+grid_checkCompiled(grid_t* grid)
+{
+  int cells = grid->rows * grid->cols;
+  int numSegments = grid->numRooms + grid->numPassages;
+  for (int i = 0; i < cells; i++) {
+    if (grid->shared->segment[i] < 0 || grid->shared->segment[i] > numSegments) {
+      return false;
+    }
+  }
+
+  unsigned char* listed = calloc(cells, 1);
+  if (listed == NULL) {
+    return false;
+  }
+  bool valid = true;
+  for (int i = 0; i < grid->numOpenCells && valid; i++) {
+    int cell = grid->shared->openCells[i];
+    valid = cell >= 0 && cell < cells && !listed[cell]
+            && grid->g[cell / grid->cols][cell % grid->cols] == '.';
+    if (valid) {
+      listed[cell] = 1;
+    }
+  }
+  free(listed);
+  return valid;
+}
+
+/**
+ * @brief: segments a grid into rooms (connected room floor)
+ * and passages (connected '#'), and lists its room floor cells.
+ * Cells are connected if they touch, diagonals included,
+ * since that is how players move.
+ *
+ * Returns:
+ * @return true: success.
+ * @return false: out of memory.
+ */
+static bool
+grid_preprocess(grid_t* grid)
+{
+  int cells = grid->rows * grid->cols;
+  grid->shared->segment = calloc(cells, sizeof(int));
+  grid->shared->openCells = malloc((cells + 1) * sizeof(int));
+  int* queue = malloc(cells * sizeof(int));
+  if (grid->shared->segment == NULL || grid->shared->openCells == NULL || queue == NULL) {
+    free(queue);
+    return false;
+  }
+
+  /* rooms first, so room ids are 1..numRooms */
+  grid->numRooms = 0;
+  grid->numOpenCells = 0;
+  for (int i = 0; i < cells; i++) {
+    if (grid->g[i / grid->cols][i % grid->cols] == '.') {
+      grid->shared->openCells[grid->numOpenCells++] = i;
+      if (grid->shared->segment[i] == 0) {
+        grid_fillSegment(grid, i, ++grid->numRooms, queue);
+      }
+    }
+  }
+
+  /* then passages */
+  grid->numPassages = 0;
+  for (int i = 0; i < cells; i++) {
+    if (grid->g[i / grid->cols][i % grid->cols] == '#' && grid->shared->segment[i] == 0) {
+      grid->numPassages++;
+      grid_fillSegment(grid, i, grid->numRooms + grid->numPassages, queue);
+    }
+  }
+
+  free(queue);
+  return grid_indexOpenCells(grid) && grid_initFreeCells(grid) && grid_buildGraph(grid);
+}
+
+/**
+ * @brief: indexes the room floor cells, so that each grid's free cells
+ * and gold piles can be kept per room floor cell rather than per cell.
+ *
+ * Returns:
+ * @return true: success.
+ * @return false: out of memory.
+ */
+static bool
+grid_indexOpenCells(grid_t* grid)
+{
+  int cells = grid->rows * grid->cols;
+  int* openIndex = malloc(cells * sizeof(int));
+  if (openIndex == NULL) {
+    return false;
+  }
+  for (int i = 0; i < cells; i++) {
+    openIndex[i] = -1;
+  }
+  for (int i = 0; i < grid->numOpenCells; i++) {
+    openIndex[grid->shared->openCells[i]] = i;
+  }
+  grid->shared->openIndex = openIndex;
+  return true;
+}
+
+/**
+ * @brief: starts the set of free spawn points with every room floor cell.
+ *
+ * Returns:
+ * @return true: success.
+ * @return false: out of memory.
+ */
+static bool
+grid_initFreeCells(grid_t* grid)
+{
+  grid->freeCells = malloc((grid->numOpenCells + 1) * sizeof(int));
+  grid->freeIndex = malloc((grid->numOpenCells + 1) * sizeof(int));
+  if (grid->freeCells == NULL || grid->freeIndex == NULL) {
+    return false;
+  }
+
+  for (int i = 0; i < grid->numOpenCells; i++) {
+    grid->freeCells[i] = grid->shared->openCells[i];
+    grid->freeIndex[i] = i;
+  }
+  grid->numFreeCells = grid->numOpenCells;
+  return true;
+}
+
+/**
+ * @brief: whether row y of a grid is its own, copied out of
+ * the shared cells by grid_setCell(), rather than shared.
+ */
+static bool
+grid_isOwnRow(grid_t* grid, int y)
+{
+  return grid->g[y] != grid->shared->cells + (size_t)y * (grid->cols + 1);
+}
+
+/**
+ * @brief: breadth-first flood fill from cell start over cells holding
+ * the same character, labelling each with segment id.
+ * queue must have room for every cell of the grid.
+ *
+ * Returns:
+ * @return int: number of cells labelled.
+ */
+static int
+grid_fillSegment(grid_t* grid, int start, int id, int* queue)
+{
+  char terrain = grid->g[start / grid->cols][start % grid->cols];
+  int head = 0, tail = 0;
+
+  grid->shared->segment[start] = id;
+  queue[tail++] = start;
+  while (head < tail) {
+    int cell = queue[head++];
+    int x = cell % grid->cols;
+    int y = cell / grid->cols;
+
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        int nx = x + dx, ny = y + dy;
+        if (nx < 0 || ny < 0 || nx >= grid->cols || ny >= grid->rows) {
+          continue;
+        }
+        int next = ny * grid->cols + nx;
+        if (grid->shared->segment[next] == 0 && grid->g[ny][nx] == terrain) {
+          grid->shared->segment[next] = id;
+          queue[tail++] = next;
+        }
+      }
+    }
+  }
+  return tail;
+}
+
+/**
+ * @brief: reads the remainder of a map file into memory with fread,
+ * doubling the buffer as needed, so loading is linear in the file size.
+ * The caller must later free the returned buffer.
+ *
+ * Returns:
+ * @return char*: the file contents (not null-terminated), or NULL on error.
+ */
+static char*
+readMapFile(FILE* mapfile, size_t* length)
+{
+  /* make sure we start from the beginning in case of prior reads */
+  rewind(mapfile);
+
+  size_t capacity = 4096;
+  size_t used = 0;
+  char* text = malloc(capacity);
+  if (text == NULL) {
+    return NULL;
+  }
+
+  size_t n;
+  while ( (n = fread(text + used, 1, capacity - used, mapfile)) > 0) {
+    used += n;
+    if (used == capacity) {
+      char* bigger = realloc(text, capacity *= 2);
+      if (bigger == NULL) {
+        free(text);
+        return NULL;
+      }
+      text = bigger;
+    }
+  }
+  if (ferror(mapfile)) {
+    free(text);
+    return NULL;
+  }
+
+  *length = used;
+  return text;
+}
@@ -20,18 +20,65 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <string.h>
-#include <float.h>
-#include <math.h>
 
 #include "file.h"         /* file operations */
 #include "message.h"      /* message operations */
 
+/**
+ * @brief: the part of a map that never changes once loaded: its cells
+ * as loaded (without gold), rooms and passages, floor cells and links.
+ * Every grid made from the map by grid_share() uses it read-only,
+ * and the last of them to be deleted frees it.
+ */
+typedef struct grid_shared {
+  int refs;             /* grids using it */
+  char* cells;          /* the map as loaded: rows of cols + 1 bytes, each '\0'-terminated */
+  int* segment;         /* per cell: room (1..numRooms), passage (above numRooms), or 0 */
+  int* openCells;       /* room floor cells (y*cols + x): valid spawn and gold spots */
+  int* openIndex;       /* per cell: its position in openCells, or -1 */
+  int* bounds;          /* per segment s: minX, minY, maxX, maxY at bounds[4*s] */
+  int* linkStart;       /* segment s touches links[linkStart[s] .. linkStart[s+1]-1] */
+  int* links;           /* rooms and the passages they open onto, both ways */
+} grid_shared_t;
+
+/**
+ * @brief: a map as one game plays on it. A grid owns only its rows
+ * that hold gold and its free cells, which cost a few bytes per
+ * room floor cell; all else is in the shared terrain.
+ */
 typedef struct grid {
-  char** g;
+  char** g;             /* rows: shared cells, until a row is first written (see grid_setCell()) */
+  grid_shared_t* shared;  /* the terrain, shared with every grid of the same map */
   int rows;
   int cols;
+  int numRooms;         /* as in the shared terrain */
+  int numPassages;
+  int numOpenCells;
+  int* freeCells;       /* room floor cells with neither gold nor a player on them */
+  int numFreeCells;
+  int* freeIndex;       /* per room floor cell (as in openCells): its position in freeCells, or -1 */
 } grid_t;
 
+/**
+ * @brief: what a player remembers of a map: one bit per cell,
+ * set once the player has seen the cell, and the few cells where
+ * it last saw gold. What a seen cell looks like is read from the
+ * master grid when the view is rendered, so that a view costs
+ * an eighth of a byte per cell rather than a copy of the map.
+ */
+typedef struct grid_view {
+  int rows;
+  int cols;
+  unsigned char* seen;  /* bit (y*cols + x) set once the cell was seen */
+  int* gold;            /* cells (y*cols + x) where gold was last seen */
+  int numGold;
+  int goldCapacity;
+} grid_view_t;
+
+/* characters a map is made of; a cell's terrain class
+   is the index of its character in this string */
+#define GRID_TERRAIN " .#|-+"
+
 typedef struct player player_t;
 typedef struct game gamestate_t;
 
@@ -41,35 +88,219 @@ typedef struct game gamestate_t;
  * This function allocates memory, which the caller
  * must later free by callind grid_delete()
  * 
+ * The file is read once, in full. The grid has one row per line
+ * and as many columns as the longest line; shorter lines are padded
+ * with spaces, and DOS line endings are accepted.
+ * All rows are stored in a single contiguous block.
+ * 
  * Inputs:
  * @param mapfile: FILE pointer to the source file containing
  * the map data. It's expected to be open for reading.
  * 
+ * The file may also be a compiled map written by grid_save();
+ * it is recognized by its header and loaded directly.
+ * Either way the grid comes back segmented into rooms and passages,
+ * with its list of room floor cells, the bounding box of each segment,
+ * and the graph of which rooms open onto which passages.
+ * 
  * Returns:
  * @return grid_t*: pointer to a grid instance containing the map data.
+ * @return NULL: the file is empty, or holds a character
+ * that is not part of a map (" .#|-+"), or is a corrupt compiled map.
  */
 grid_t* grid_init(FILE* mapfile);
 
 
 /**
- * @brief: function to initialize a grid for a new player.
- * Rather than loading a player from FILE, 
- * this function takes in a pointer to a master grid
- * and copies needed information from that grid instance.
+ * @brief: function to save a grid in the compiled map format,
+ * which grid_init() loads without parsing the text map.
+ * The compiled map holds the dimensions, the terrain class of every cell,
+ * the room/passage segment of every cell, and the room floor cells
+ * where players may spawn and gold may be placed.
+ * 
+ * Inputs:
+ * @param grid: pointer to a grid created by grid_init().
+ * @param fp: FILE pointer open for writing (in binary mode).
+ * 
+ * Returns:
+ * @return true: the compiled map was written.
+ * @return false: NULL arguments, an unprocessed grid, or a write error.
+ * 
+ * NOTE: integers are written in host byte order;
+ * compile maps on the architecture that will load them.
+ */
+bool grid_save(grid_t* grid, FILE* fp);
+
+
+/**
+ * @brief: function to make another grid of the same map, e.g. for
+ * another game: it shares the original's terrain, rooms and passages,
+ * read-only, but has its own gold and players, starting with none.
+ * 
+ * Inputs:
+ * @param grid: a grid from grid_init() or grid_share().
+ * 
+ * Returns:
+ * @return grid_t*: the new grid, as the map was loaded.
+ * @return NULL: NULL grid, or out of memory.
+ * 
+ * NOTE: the caller must later free it by calling grid_delete();
+ * the shared terrain is freed with the last grid using it.
+ */
+grid_t* grid_share(grid_t* grid);
+
+
+/**
+ * @brief: function to change one cell of a grid, e.g. to place
+ * or take gold. The cell's row is copied out of the shared terrain
+ * the first time it changes, so that other grids of the map
+ * do not see the change.
+ * 
+ * Inputs:
+ * @param grid: the grid.
+ * @param x, y: the cell.
+ * @param c: its new character.
+ * 
+ * Returns:
+ * @return true: the cell holds c.
+ * @return false: out of the map, or out of memory; the cell is unchanged.
+ * 
+ * NOTE: write cells through this function, never through grid->g.
+ */
+bool grid_setCell(grid_t* grid, int x, int y, char c);
+
+
+/**
+ * @brief: function to initialize the view of a new player,
+ * who has seen nothing yet of the master grid.
  * 
  * Inputs: 
- * @param masterGrid 
+ * @param masterGrid: the map the player plays on.
  * 
  * Returns:
- * @return grid_t*: pointer to grid struct
+ * @return grid_view_t*: pointer to an empty view of the map's size.
+ * @return NULL: NULL grid, or out of memory.
+ * 
+ * NOTE: the caller must later free it by calling grid_deleteView().
+ */
+grid_view_t* grid_initForPlayer(grid_t* masterGrid);
+
+
+/**
+ * @brief: function to record that a player sees a cell
+ * as it now is on the master grid (with or without gold).
+ * 
+ * Inputs:
+ * @param grid: the master grid.
+ * @param view: the player's view.
+ * @param x, y: the cell, on the map.
+ * 
+ * Returns: None.
  */
-grid_t* grid_initForPlayer(grid_t* masterGrid);
+void grid_viewCell(grid_t* grid, grid_view_t* view, int x, int y);
 
 
+/**
+ * @brief: function to free a player's view.
+ * 
+ * Inputs:
+ * @param view: the view (may be NULL).
+ * 
+ * Returns: None.
+ */
+void grid_deleteView(grid_view_t* view);
+
+
+/**
+ * @brief: function to check whether one player can see another.
+ * In a room, players see each other in line of sight (see
+ * grid_calculateVisibility()); players in passages see each other
+ * only from next to each other, in the passage, and are not seen
+ * from rooms, nor see into them.
+ * 
+ * Inputs:
+ * @param gamestate: the gamestate.
+ * @param Grid: the master grid.
+ * @param player: the player looking.
+ * @param player2: the player looked at.
+ * 
+ * Returns:
+ * @return true: player can see player2; the relation is symmetric.
+ * @return false: player cannot see player2.
+ */
 bool grid_isPlayerVisible(gamestate_t* gamestate, grid_t* Grid, player_t* player, player_t* player2);
 
 char* grid_toStringForPlayer(gamestate_t* state, player_t* current_player);
 
+/**
+ * @brief: function to render a player's view, as grid_toStringForPlayer()
+ * does, into a buffer the caller provides, e.g. one kept from frame
+ * to frame, so that rendering allocates nothing.
+ * 
+ * Inputs:
+ * @param state: the gamestate.
+ * @param current_player: the player.
+ * @param out: room for rows * (cols + 1) + 1 bytes.
+ * 
+ * Returns:
+ * @return size_t: the length of the text written, not counting its '\0'.
+ */
+size_t grid_writeForPlayer(gamestate_t* state, player_t* current_player, char* out);
+
+/**
+ * @brief: function to render only a window of a player's view,
+ * centred on the player as far as the edges of the map allow.
+ * Costs are proportional to the window, not the map.
+ * 
+ * Inputs:
+ * @param state: the gamestate.
+ * @param current_player: the player, whose view was last updated
+ * by grid_calculateVisibility().
+ * @param rows: height of the window; at most the map's.
+ * @param cols: width of the window; at most the map's.
+ * @param top: filled in with the map row shown on the window's first line.
+ * @param left: filled in with the map column shown in its first column.
+ * 
+ * Returns:
+ * @return char*: the window as text, one line per row, with newlines
+ * between rows, and '@' for the player. The caller must free it.
+ * @return NULL: bad arguments, or out of memory.
+ */
+char* grid_windowForPlayer(gamestate_t* state, player_t* current_player,
+                           int rows, int cols, int* top, int* left);
+
+/**
+ * @brief: function to fit a window on a grid, centred on the player
+ * as far as the edges of the map allow.
+ * 
+ * Inputs:
+ * @param grid: the grid.
+ * @param current_player: the player.
+ * @param rows, cols: the size of the window; shrunk to the map's if larger.
+ * @param top, left: filled in with the map row and column at the window's
+ * top left corner.
+ * 
+ * Returns: None.
+ */
+void grid_fitWindow(grid_t* grid, player_t* current_player,
+                    int* rows, int* cols, int* top, int* left);
+
+/**
+ * @brief: function to render a window of a player's view, as
+ * grid_windowForPlayer() does, into a buffer the caller provides.
+ * 
+ * Inputs:
+ * @param state: the gamestate.
+ * @param current_player: the player.
+ * @param rows, cols, top, left: the window, as fitted by grid_fitWindow().
+ * @param out: room for rows * (cols + 1) + 1 bytes.
+ * 
+ * Returns:
+ * @return size_t: the length of the text written, not counting its '\0'.
+ */
+size_t grid_writeWindowForPlayer(gamestate_t* state, player_t* current_player,
+                                 int rows, int cols, int top, int left, char* out);
+
 void grid_movePlayer(gamestate_t* gameState, player_t* player, int x, int y);
 
 /**
@@ -77,7 +308,7 @@ void grid_movePlayer(gamestate_t* gameState, player_t* player, int x, int y);
  * and free all allocated memory.
  * The grid struct should have been created
  * via a call to either grid_init()
- * or grid_initForPlayer()
+ * or grid_copy()
  * 
  * Inputs:
  * @param grid: the grid instance
@@ -210,6 +441,101 @@ bool grid_isPassage(grid_t* grid, int x, int y);
 bool grid_isSpace(grid_t* grid, int x, int y);
 
 
+/**
+ * @brief: function to mark a cell as taken, by gold or a player,
+ * so that it is no longer a free spawn point.
+ * Does nothing if the cell is already taken or is not room floor.
+ * 
+ * Inputs:
+ * @param grid: pointer to the master grid.
+ * @param x: x position of the cell.
+ * @param y: y position of the cell.
+ * 
+ * Returns: None.
+ */
+void grid_claimCell(grid_t* grid, int x, int y);
+
+
+/**
+ * @brief: function to mark a cell as no longer taken.
+ * The cell becomes a free spawn point again only if it was
+ * room floor when the map was loaded (see grid_roomAt())
+ * and has no gold on it; passages and doorways never do.
+ * 
+ * Inputs:
+ * @param grid: pointer to the master grid.
+ * @param x: x position of the cell.
+ * @param y: y position of the cell.
+ * 
+ * Returns: None.
+ */
+void grid_releaseCell(grid_t* grid, int x, int y);
+
+
+/**
+ * @brief: function to find the room or passage a cell belongs to.
+ * 
+ * Inputs:
+ * @param grid: pointer to the master grid.
+ * @param x: x position of the cell.
+ * @param y: y position of the cell.
+ * 
+ * Returns:
+ * @return int: the room id (1..numRooms) or passage id
+ * (numRooms+1 .. numRooms+numPassages) of the cell,
+ * or 0 for walls, rock, and cells off the map.
+ */
+int grid_segmentAt(grid_t* grid, int x, int y);
+
+
+/**
+ * @brief: function to find the room a cell belongs to.
+ * 
+ * Inputs:
+ * @param grid: pointer to the master grid.
+ * @param x: x position of the cell.
+ * @param y: y position of the cell.
+ * 
+ * Returns:
+ * @return int: the room id (1..numRooms) of a room floor cell,
+ * or 0 for any other cell (passages, walls, rock, off the map).
+ */
+int grid_roomAt(grid_t* grid, int x, int y);
+
+
+/**
+ * @brief: function to get the segments (rooms or passages)
+ * that a segment connects to: the passages opening off a room,
+ * or the rooms a passage leads to.
+ * 
+ * Inputs:
+ * @param grid: pointer to the master grid.
+ * @param segment: a room (1..numRooms) or passage
+ * (numRooms+1 .. numRooms+numPassages) id.
+ * @param count: filled in with the number of linked segments.
+ * 
+ * Returns:
+ * @return const int*: the linked segment ids, or NULL if there are none.
+ */
+const int* grid_getLinks(grid_t* grid, int segment, int* count);
+
+
+/**
+ * @brief: function to pick a free spawn point uniformly at random,
+ * in constant time, from the cells not claimed by gold or players.
+ * 
+ * Inputs:
+ * @param grid: pointer to the master grid.
+ * @param x: filled in with the x position of the cell.
+ * @param y: filled in with the y position of the cell.
+ * 
+ * Returns:
+ * @return true: a free cell was found.
+ * @return false: every room floor cell is taken.
+ */
+bool grid_randomFreeCell(grid_t* grid, int* x, int* y);
+
+
 /**
  * @brief: function to check if a player can move in some
  * direction given a key.
@@ -225,6 +551,21 @@ bool grid_isSpace(grid_t* grid, int x, int y);
  */
 bool grid_canMove(grid_t* master, player_t* player, char k);
 
+/**
+ * @brief: function to update a player's view of the map,
+ * from where they stand.
+ * Walls, passages and rock block vision, so a player sees no further
+ * than the walls of the room they are in; only that room's bounding box
+ * (and that of the room they last saw, whose gold is forgotten) is scanned.
+ * A player in a passage sees the cell they stand on and the passage
+ * cells next to it (doorways included), but nothing of the rooms.
+ * 
+ * Inputs:
+ * @param Grid: pointer to the master grid.
+ * @param player: the player, whose grid is updated.
+ * 
+ * Returns: None.
+ */
 void grid_calculateVisibility(grid_t* Grid, player_t* player);
 
 /**
@@ -283,4 +624,19 @@ grid_t* grid_copy(grid_t* original_grid);
  */
 char* grid_toString(gamestate_t* state, grid_t* grid);
 
+
+/**
+ * @brief: function to render a grid and every player on it, as
+ * grid_toString() does, into a buffer the caller provides.
+ * 
+ * Inputs:
+ * @param state: the gamestate.
+ * @param grid: the grid.
+ * @param out: room for rows * (cols + 1) + 1 bytes.
+ * 
+ * Returns:
+ * @return size_t: the length of the text written, not counting its '\0'.
+ */
+size_t grid_write(gamestate_t* state, grid_t* grid, char* out);
+
 #endif /* __GRID_H */
\ No newline at end of file
@@ -0,0 +1,138 @@
+/**
+ * @file mapc.c
+ * @author TEAM PINE
+ * @brief: the map compiler. Validates a text map offline and writes it
+ * in the compiled map format, which the server loads without parsing,
+ * already segmented into rooms and passages and with its list of
+ * cells where players may spawn and gold may be placed.
+ *
+ * usage: ./mapc textMap compiledMap
+ * e.g.:  ./mapc maps/main.txt maps/main.map
+ *        ./server maps/main.map 257573
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "grid.h"         /* grid module */
+
+// Function prototypes
+static bool validateMap(grid_t* grid);
+static int countLeaks(grid_t* grid);
+
+/**
+ * @brief checks a loaded map for problems that would only show up
+ * at runtime, printing what it finds.
+ *
+ * Inputs:
+ * @param grid: the map, loaded by grid_init()
+ *
+ * Returns:
+ * @return true: the map is fit to play on (warnings aside).
+ * @return false: the map must be rejected.
+ */
+static bool
+validateMap(grid_t* grid)
+{
+  // Players and gold need somewhere to go
+  if (grid->numOpenCells == 0) {
+    fprintf(stderr, "error: map has no room floor ('.') cells\n");
+    return false;
+  }
+
+  // Room floor should be enclosed by walls
+  int leaks = countLeaks(grid);
+  if (leaks > 0) {
+    fprintf(stderr, "warning: %d room floor cells touch solid rock or the map edge\n", leaks);
+  }
+
+  return true;
+}
+
+/**
+ * @brief counts room floor cells that touch solid rock (' ')
+ * or the edge of the map, i.e. rooms that are not walled in.
+ */
+static int
+countLeaks(grid_t* grid)
+{
+  int leaks = 0;
+  for (int i = 0; i < grid->numOpenCells; i++) {
+    int x = grid->shared->openCells[i] % grid->cols;
+    int y = grid->shared->openCells[i] / grid->cols;
+    bool leaking = false;
+
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        int nx = x + dx, ny = y + dy;
+        if (nx < 0 || ny < 0 || nx >= grid->cols || ny >= grid->rows
+            || grid->g[ny][nx] == ' ') {
+          leaking = true;
+        }
+      }
+    }
+    if (leaking) {
+      leaks++;
+    }
+  }
+  return leaks;
+}
+
+int
+main(const int argc, const char* argv[])
+{
+  // Check for illegal # of arguments
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s textMap compiledMap\n", argv[0]);
+    exit(1);
+  }
+
+  // Load and validate the text map
+  FILE* in = fopen(argv[1], "r");
+  if (in == NULL) {
+    fprintf(stderr, "error: could not open '%s'\n", argv[1]);
+    exit(1);
+  }
+  grid_t* grid = grid_init(in);
+  fclose(in);
+
+  if (grid == NULL) {
+    fprintf(stderr, "error: '%s' is not a valid map\n", argv[1]);
+    exit(2);
+  }
+  if (!validateMap(grid)) {
+    grid_delete(grid);
+    exit(2);
+  }
+
+  // Write the compiled map
+  FILE* out = fopen(argv[2], "wb");
+  if (out == NULL) {
+    fprintf(stderr, "error: could not open '%s' for writing\n", argv[2]);
+    grid_delete(grid);
+    exit(1);
+  }
+  bool saved = grid_save(grid, out);
+  if (fclose(out) != 0 || !saved) {
+    fprintf(stderr, "error: could not write '%s'\n", argv[2]);
+    grid_delete(grid);
+    exit(3);
+  }
+
+  // Each room-passage link is listed from both ends
+  int numSegments = grid->numRooms + grid->numPassages;
+  int numLinks = grid->shared->linkStart[numSegments + 1] / 2;
+  printf("%s: %d x %d, %d rooms, %d passages, %d links, %d floor cells\n", argv[2],
+         grid->rows, grid->cols, grid->numRooms, grid->numPassages,
+         numLinks, grid->numOpenCells);
+
+  grid_delete(grid);
+  return 0;
+}
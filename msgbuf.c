@@ -0,0 +1,155 @@
+/**
+ * @file msgbuf.c
+ * @author TEAM PINE
+ * @brief: implements functionality for the msgbuf module.
+ * A msgbuf is a reusable, growable buffer in which to build
+ * outgoing messages.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "msgbuf.h"     /* self */
+
+/************** Exported functions ***************/
+
+/**
+ * @brief: constructor.
+ * See msgbuf.h for detailed documentation.
+ */
+msgbuf_t*
+msgbuf_new(size_t capacity)
+{
+  msgbuf_t* buf = malloc(sizeof(msgbuf_t));
+  if (buf == NULL) {
+    return NULL;
+  }
+
+  buf->capacity = (capacity > 0) ? capacity : 1;
+  buf->text = malloc(buf->capacity);
+  if (buf->text == NULL) {
+    free(buf);
+    return NULL;
+  }
+  buf->text[0] = '\0';
+  buf->length = 0;
+  return buf;
+}
+
+
+/**
+ * @brief: function to empty a buffer.
+ * See msgbuf.h for detailed documentation.
+ */
+void
+msgbuf_clear(msgbuf_t* buf)
+{
+  buf->length = 0;
+  buf->text[0] = '\0';
+}
+
+
+/**
+ * @brief: function to make room for more bytes at the end of a buffer.
+ * See msgbuf.h for detailed documentation.
+ */
+bool
+msgbuf_reserve(msgbuf_t* buf, size_t extra)
+{
+  size_t needed = buf->length + extra + 1;
+  if (needed <= buf->capacity) {
+    return true;
+  }
+
+  /* at least double, so appends take amortized constant time */
+  size_t capacity = 2 * buf->capacity;
+  if (capacity < needed) {
+    capacity = needed;
+  }
+  char* grown = realloc(buf->text, capacity);
+  if (grown == NULL) {
+    return false;
+  }
+  buf->text = grown;
+  buf->capacity = capacity;
+  return true;
+}
+
+
+/**
+ * @brief: function to append a string to a buffer.
+ * See msgbuf.h for detailed documentation.
+ */
+void
+msgbuf_append(msgbuf_t* buf, const char* text)
+{
+  size_t length = strlen(text);
+  if (msgbuf_reserve(buf, length)) {
+    memcpy(buf->text + buf->length, text, length + 1);
+    buf->length += length;
+  }
+}
+
+
+/**
+ * @brief: function to append a character to a buffer.
+ * See msgbuf.h for detailed documentation.
+ */
+void
+msgbuf_appendChar(msgbuf_t* buf, char c)
+{
+  if (msgbuf_reserve(buf, 1)) {
+    buf->text[buf->length++] = c;
+    buf->text[buf->length] = '\0';
+  }
+}
+
+
+/**
+ * @brief: function to append an integer, in decimal, to a buffer.
+ * See msgbuf.h for detailed documentation.
+ */
+void
+msgbuf_appendInt(msgbuf_t* buf, int n)
+{
+  /* digits come out last first; unsigned, so INT_MIN negates safely */
+  char digits[12];
+  int count = 0;
+  unsigned int value = (n < 0) ? 0u - (unsigned int)n : (unsigned int)n;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+
+  if (msgbuf_reserve(buf, count + 1)) {
+    if (n < 0) {
+      buf->text[buf->length++] = '-';
+    }
+    while (count > 0) {
+      buf->text[buf->length++] = digits[--count];
+    }
+    buf->text[buf->length] = '\0';
+  }
+}
+
+
+/**
+ * @brief: function to free a buffer and its text.
+ * See msgbuf.h for detailed documentation.
+ */
+void
+msgbuf_delete(msgbuf_t* buf)
+{
+  if (buf != NULL) {
+    free(buf->text);
+    free(buf);
+  }
+}
@@ -0,0 +1,106 @@
+/**
+ * @file msgbuf.h
+ * @author TEAM PINE
+ * @brief: exports functionality for the msgbuf module.
+ * A msgbuf is a reusable, growable buffer in which to build
+ * outgoing messages. The server keeps one per game, in which every
+ * message to a player or spectator is built and sent in turn, and the
+ * transport one per batching client, for the messages it holds; so
+ * building a message allocates nothing once the buffer has grown to fit,
+ * and integers are formatted without going through printf.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef __MSGBUF_H
+#define __MSGBUF_H
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * @brief: a message under construction.
+ * text is always '\0'-terminated, length bytes long.
+ */
+typedef struct msgbuf {
+  char* text;         /* the message so far */
+  size_t length;      /* bytes in text, not counting the '\0' */
+  size_t capacity;    /* bytes allocated for text */
+} msgbuf_t;
+
+
+/**
+ * @brief: constructor.
+ *
+ * Inputs:
+ * @param capacity: bytes to allocate up front; the buffer grows as needed.
+ *
+ * Returns:
+ * @return msgbuf_t*: an empty buffer.
+ * @return NULL: out of memory.
+ *
+ * NOTE: the caller must later free it by calling msgbuf_delete().
+ */
+msgbuf_t* msgbuf_new(size_t capacity);
+
+
+/**
+ * @brief: function to empty a buffer, keeping its memory
+ * for the next message.
+ *
+ * Inputs:
+ * @param buf: the buffer.
+ *
+ * Returns: None.
+ */
+void msgbuf_clear(msgbuf_t* buf);
+
+
+/**
+ * @brief: function to make room for more bytes at the end of a buffer,
+ * e.g. to write into buf->text + buf->length directly.
+ *
+ * Inputs:
+ * @param buf: the buffer.
+ * @param extra: bytes to make room for, besides the '\0'.
+ *
+ * Returns:
+ * @return true: there is room.
+ * @return false: out of memory; the buffer is unchanged.
+ */
+bool msgbuf_reserve(msgbuf_t* buf, size_t extra);
+
+
+/**
+ * @brief: functions to append a string, a character,
+ * or an integer in decimal, to a buffer.
+ *
+ * Inputs:
+ * @param buf: the buffer.
+ * @param text / c / n: what to append.
+ *
+ * Returns: None.
+ *
+ * NOTE: if memory runs out, nothing is appended.
+ */
+void msgbuf_append(msgbuf_t* buf, const char* text);
+void msgbuf_appendChar(msgbuf_t* buf, char c);
+void msgbuf_appendInt(msgbuf_t* buf, int n);
+
+
+/**
+ * @brief: function to free a buffer and its text.
+ *
+ * Inputs:
+ * @param buf: the buffer (may be NULL).
+ *
+ * Returns: None.
+ */
+void msgbuf_delete(msgbuf_t* buf);
+
+#endif /* __MSGBUF_H */
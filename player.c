@@ -17,6 +17,7 @@
 
 #include "message.h"  /* message module */
 #include "grid.h"     /* grid module */
+#include "transport.h"  /* transport module */
 #include "player.h"   /* self */
 #include "log.h"
 
@@ -30,7 +31,7 @@
  * @param address: the player's address (addr_t)
  * @param x: the player's starting x coordinate.
  * @param y: the player's starting y coordinate.
- * @param grid: a grid instance to track the player's
+ * @param view: a view, from grid_initForPlayer(), to track the player's
  * view of the world.
  * 
  * Returns:
@@ -41,22 +42,33 @@
  * The caller must later free that pointer by calling player_delete().
  */
 player_t* 
-player_new(char letter, char* name, addr_t address, int x, int y, grid_t* grid) 
+player_new(char letter, char* name, addr_t address, int x, int y, grid_view_t* view) 
 {
   /* allocate memory for struct */
   player_t* player = malloc(sizeof(player_t));
 
   /* save data in struct */
+  player->id = -1;
+  player->slot = -1;
   player->letter = letter;
-  player->name = malloc(sizeof(name));
+  player->name = malloc(strlen(name) + 1);
   strcpy(player->name, name);
 
   player->address = address;
   player->gold = 0;
-  player->hasQuit = false;
+  player->status = PLAYER_ACTIVE;
   player->x = x;
   player->y = y;
-  player->grid = grid;
+  player->view = view;
+  player->viewRoom = 0;
+  player->shownSegment = -1;
+  player->shownVersion = 0;
+  player->viewRows = 0;
+  player->viewCols = 0;
+  player->shownPurse = -1;
+  player->shownRemaining = -1;
+  player->lastHeard = 0;
+  player->isIdle = false;
 
   /* return pointer to player struct */
   return player;
@@ -76,6 +88,7 @@ player_addGold(player_t* player, int numGold)
   /* cannot assign gold to NULL player */
   if (player != NULL) {
     player->gold += numGold;
+    return;
   }
   /* print error message IF player is NULL */
   flog_v(stderr, "Attempt to assign gold to NULL player. Stop.\n");
@@ -234,7 +247,36 @@ void
 player_send(player_t* player, char* message)
 {
   if (player != NULL && message != NULL) {
-    message_send(player->address, message);
+    transport_send(player->address, message);
+  }
+}
+
+
+/**
+ * @brief: function to check whether a player is still in the game.
+ * See player.h for detailed documentation.
+ */
+bool
+player_isActive(player_t* player)
+{
+  return player != NULL && player->status == PLAYER_ACTIVE;
+}
+
+
+/**
+ * @brief: function to take a player out of the game.
+ * See player.h for detailed documentation.
+ */
+void
+player_leave(player_t* player, player_status_t status)
+{
+  if (player != NULL && player->status == PLAYER_ACTIVE) {
+    player->status = status;
+    player->slot = -1;
+
+    // A player off the map needs no view
+    grid_deleteView(player->view);
+    player->view = NULL;
   }
 }
 
@@ -255,8 +297,8 @@ void
 player_delete(player_t* player)
 {
   if (player != NULL) {
-    // Free player associated grid
-    grid_delete(player->grid);
+    // Free player associated view
+    grid_deleteView(player->view);
     
     // Free player name
     free(player->name);
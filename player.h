@@ -21,22 +21,44 @@
 #include "message.h"  /* message module */
 #include "grid.h"     /* grid module */
 
+/**
+ * @brief: where a player is in its life in the game.
+ * Only active players are on the map; the others are kept
+ * for the final scoreboard, as just their letter, name and gold.
+ */
+typedef enum player_status {
+  PLAYER_ACTIVE,          /* in the game */
+  PLAYER_QUIT,            /* left the game by quitting */
+  PLAYER_DISCONNECTED     /* evicted after falling silent */
+} player_status_t;
+
 /**
  * @brief: struct to represent a player.
- * This struct hold their name, assigned letter,
+ * This struct hold their id, name, assigned letter,
  * communication address, gold collected, 
  * their position in the game, 
- * and a grid tracking their view of the world.
+ * and a view tracking what they have seen of the world.
  */
 typedef struct player {
-  char letter;
+  int id;         /* index in the game's players array; -1 until added */
+  int slot;       /* row in the game's visibility matrix; -1 if not in it */
+  char letter;    /* label shown on the map; may be reused, see gamestate_nextLabel() */
   char* name;
   addr_t address;
   int gold;
   int x;
   int y;
-  grid_t* grid;
-  bool hasQuit;
+  grid_view_t* view;   /* what the player has seen; NULL once the player has left */
+  int viewRoom;   /* room whose view was last updated; 0 if none */
+  int shownSegment;   /* room or passage the last DISPLAY was sent from; -1 if none */
+  int shownVersion;   /* that segment's version when it was sent */
+  int viewRows;   /* height of the player's viewport; 0 to be sent the whole map */
+  int viewCols;   /* width of the player's viewport */
+  int shownPurse;       /* purse in the last GOLD sent; -1 if none */
+  int shownRemaining;   /* nuggets left in the last GOLD sent; -1 if none */
+  double lastHeard;     /* game time (seconds) of the player's last message */
+  bool isIdle;          /* silent too long: sent nothing until heard from again */
+  player_status_t status;
 } player_t;
 
 /**
@@ -48,7 +70,7 @@ typedef struct player {
  * @param address: the player's address (addr_t)
  * @param x: the player's starting x coordinate.
  * @param y: the player's starting y coordinate.
- * @param grid: a grid instance to track the player's
+ * @param view: a view, from grid_initForPlayer(), to track the player's
  * view of the world.
  * 
  * Returns:
@@ -58,7 +80,7 @@ typedef struct player {
  * NOTE: this function allocates memory for the player struct.
  * The caller must later free that pointer by calling player_delete().
  */
-player_t* player_new(char letter, char* name, addr_t address, int x, int y, grid_t* grid);
+player_t* player_new(char letter, char* name, addr_t address, int x, int y, grid_view_t* view);
 
 
 /**
@@ -75,6 +97,36 @@ player_t* player_new(char letter, char* name, addr_t address, int x, int y, grid
 void player_send(player_t* player, char* message);
 
 
+/**
+ * @brief: function to check whether a player is still in the game.
+ * 
+ * Inputs:
+ * @param player: pointer to a player struct.
+ * 
+ * Returns:
+ * @return true: the player is active.
+ * @return false: the player has quit or been disconnected (or is NULL).
+ */
+bool player_isActive(player_t* player);
+
+
+/**
+ * @brief: function to take a player out of the game,
+ * keeping only what the scoreboard needs.
+ * 
+ * Inputs:
+ * @param player: pointer to a player struct.
+ * @param status: PLAYER_QUIT or PLAYER_DISCONNECTED.
+ * 
+ * Returns: None
+ * 
+ * NOTE: frees the player's view; the caller must
+ * release the player's cell on the map. Messages may still
+ * be sent to the player with player_send().
+ */
+void player_leave(player_t* player, player_status_t status);
+
+
 /**
  * @brief: this function finds the letter assigned to a given player.
  * 
@@ -0,0 +1,170 @@
+/**
+ * @file replay.c
+ * @author TEAM PINE
+ * @brief: implements functionality for the replay module.
+ * The replay module records the messages a server receives,
+ * and later feeds such a recording back through the server's
+ * message handler without a network, as fast as possible.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "file.h"       /* file operations */
+#include "message.h"    /* message module */
+#include "log.h"
+#include "replay.h"     /* self */
+
+/******** static function prototypes *******/
+static bool parseRecord(char* line, double* timestamp, addr_t* from, char** message);
+
+/******** module variables *******/
+static double currentTime = 0;    /* timestamp of the record being replayed */
+
+/************** Exported functions ***************/
+
+/**
+ * @brief: function to append one received message to a recording.
+ * See replay.h for detailed documentation.
+ */
+void
+replay_record(FILE* fp, double timestamp, const addr_t from, const char* message)
+{
+  if (fp == NULL || message == NULL) {
+    return;
+  }
+
+  /* only the first line of a message fits in a record */
+  int length = strcspn(message, "\n");
+
+  fprintf(fp, "%f %s:%d %.*s\n", timestamp,
+          inet_ntoa(from.sin_addr), ntohs(from.sin_port),
+          length, message);
+  fflush(fp);
+}
+
+
+/**
+ * @brief: function to feed every message in a recording,
+ * in order, to the given message handler.
+ * See replay.h for detailed documentation.
+ */
+bool
+replay_loop(FILE* fp, void* arg,
+            bool (*handleMessage)(void* arg,
+                                  const addr_t from,
+                                  const char* message))
+{
+  if (fp == NULL || handleMessage == NULL) {
+    flog_v(stderr, "replay_loop called with NULL recording or handler. Stop.\n");
+    return false;
+  }
+
+  int replayed = 0;                 /* messages handed to the handler */
+  int lineNumber = 0;               /* position in the recording */
+  clock_t start = clock();          /* CPU time spent replaying */
+
+  char* line;
+  while ( (line = file_readLine(fp)) != NULL) {
+    lineNumber++;
+
+    double timestamp;
+    addr_t from;
+    char* message;
+
+    /* skip blank lines; log and skip malformed ones */
+    if (line[0] == '\0') {
+      free(line);
+      continue;
+    }
+    if (!parseRecord(line, &timestamp, &from, &message)) {
+      flog_d(stderr, "replay: skipping malformed record on line %d", lineNumber);
+      free(line);
+      continue;
+    }
+
+    currentTime = timestamp;
+    replayed++;
+    bool done = (*handleMessage)(arg, from, message);
+    free(line);
+
+    if (done) {
+      break;    /* handler says to stop */
+    }
+  }
+
+  double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  flog_d(stderr, "replay: %d messages replayed", replayed);
+  if (seconds > 0) {
+    flog_d(stderr, "replay: %d messages per CPU second", (int)(replayed / seconds));
+  }
+
+  currentTime = 0;
+  return true;
+}
+
+
+/**
+ * @brief: function to get the timestamp of the record
+ * currently being replayed.
+ * See replay.h for detailed documentation.
+ */
+double
+replay_time(void)
+{
+  return currentTime;
+}
+
+
+/**************** Static Functions ******************/
+
+/**
+ * @brief: splits a record of the form "<timestamp> <host>:<port> <message>"
+ * into its parts. The line is modified in place;
+ * *message points into it on return.
+ *
+ * Returns:
+ * @return true: the record is well-formed.
+ * @return false: the record is malformed, outputs are undefined.
+ */
+static bool
+parseRecord(char* line, double* timestamp, addr_t* from, char** message)
+{
+  /* timestamp */
+  char* rest;
+  *timestamp = strtod(line, &rest);
+  if (rest == line || *rest != ' ') {
+    return false;
+  }
+
+  /* address, up to the next space */
+  char* host = rest + 1;
+  char* space = strchr(host, ' ');
+  if (space == NULL) {
+    return false;
+  }
+  *space = '\0';
+
+  /* split host from port at the last colon */
+  char* colon = strrchr(host, ':');
+  if (colon == NULL) {
+    return false;
+  }
+  *colon = '\0';
+  if (!message_setAddr(host, colon + 1, from)) {
+    return false;
+  }
+
+  /* the message is the remainder of the line */
+  *message = space + 1;
+  return **message != '\0';
+}
@@ -0,0 +1,96 @@
+/**
+ * @file replay.h
+ * @author TEAM PINE
+ * @brief: exports functionality for the replay module.
+ * The replay module records the messages a server receives,
+ * and later feeds such a recording back through the server's
+ * message handler without a network, as fast as possible.
+ * Together with the seed given to the server, a recording
+ * reproduces a game exactly, as long as the server changes the game
+ * only while handling a message (players are idled and evicted then,
+ * never on a timeout, which a recording does not capture).
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef __REPLAY_H
+#define __REPLAY_H
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "message.h"    /* message module */
+
+/**
+ * A recording is a text file holding one received message per line:
+ *
+ *    <timestamp> <host>:<port> <message>
+ *
+ * where timestamp is in seconds (with a fractional part),
+ * and message is the rest of the line, verbatim.
+ * e.g.:
+ *    1622505600.125000 127.0.0.1:59957 PLAY Alice
+ *    1622505600.982311 127.0.0.1:59957 KEY l
+ */
+
+
+/**
+ * @brief: function to append one received message to a recording.
+ *
+ * Inputs:
+ * @param fp: FILE pointer to the recording, open for writing.
+ * @param timestamp: the time (in seconds) the message was received.
+ * @param from: the address the message arrived from.
+ * @param message: the message text.
+ *
+ * Returns: None.
+ *
+ * NOTE: messages containing a newline cannot be represented
+ * in a recording; only their first line is recorded.
+ */
+void replay_record(FILE* fp, double timestamp, const addr_t from, const char* message);
+
+
+/**
+ * @brief: function to feed every message in a recording,
+ * in order, to the given message handler.
+ * Mirrors message_loop(), but reads from a file instead of a socket
+ * and does not wait between messages.
+ *
+ * Inputs:
+ * @param fp: FILE pointer to the recording, open for reading.
+ * @param arg: pointer passed through untouched to the handler.
+ * @param handleMessage: handler called once per recorded message.
+ * It should return true to stop the replay, false to keep going.
+ *
+ * Returns:
+ * @return true: the replay ended normally
+ * (end of the recording, or the handler returned true).
+ * @return false: fatal error, e.g. NULL arguments.
+ *
+ * NOTE: malformed lines in the recording are logged and skipped.
+ * The timestamp of the record being replayed is available
+ * to the handler through replay_time().
+ */
+bool replay_loop(FILE* fp, void* arg,
+                 bool (*handleMessage)(void* arg,
+                                       const addr_t from,
+                                       const char* message));
+
+
+/**
+ * @brief: function to get the timestamp of the record
+ * currently being replayed.
+ *
+ * Returns:
+ * @return double: timestamp (in seconds) of the current record,
+ * or 0 if no replay is running.
+ */
+double replay_time(void);
+
+#endif /* __REPLAY_H */
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <string.h>
+#include <time.h>
 
 #include "file.h"         /* file operations */
 #include "message.h"      /* message operations */
@@ -26,6 +27,10 @@
 #include "gold.h"         /* gold module */
 #include "player.h"       /* player module */
 #include "spectator.h"    /* spectator module */
+#include "replay.h"       /* replay module */
+#include "transport.h"    /* transport module */
+#include "msgbuf.h"       /* msgbuf module */
+#include "catalog.h"      /* catalog module */
 
 // Global Variables
 const int MaxNameLength = 50;
@@ -33,45 +38,90 @@ const int MaxPlayers = 26;
 int GoldTotal = 250;
 const int GoldMinNumPiles = 10;
 const int GoldMaxNumPiles = 30;
+const int GoldDefaultNumPiles = 26;
+const int IdleSeconds = 0;          /* silence after which a player is sent nothing; 0 for never */
+const int EvictSeconds = 0;         /* silence after which a player is made to quit; 0 for never */
 
+/**
+ * @brief: command-line options for the server.
+ * replayFile, recordFile and transcriptFile are NULL unless requested.
+ */
+typedef struct options {
+  const char* mapFile;          /* path to the map */
+  int seed;                     /* seed for the random number generator */
+  const char* replayFile;       /* recording to replay instead of listening */
+  const char* recordFile;       /* file to record received messages in */
+  const char* transcriptFile;   /* file to write messages sent during a replay in */
+  gold_policy_t goldPolicy;     /* how to scatter the gold piles */
+  int goldTotal;                /* nuggets in the game */
+  int goldPiles;                /* piles to share the nuggets among */
+  int maxPlayers;               /* most players that may join */
+  int spectatorFPS;             /* most frames per second to a spectator; 0 for all */
+  spectator_refresh_t spectatorRefresh;   /* how to refresh spectators */
+  int idleAfter;                /* seconds of silence before a player is idle; 0 for never */
+  int evictAfter;               /* seconds of silence before a player is evicted; 0 for never */
+  const char* rotateDir;        /* directory of maps to play in turn, NULL for one game */
+} options_t;
+
+static FILE* recordFP = NULL;   /* open recording, NULL if not recording */
+static msgbuf_t* gridMessage = NULL;      /* "GRID rows cols", built once per game */
+static msgbuf_t* outbox = NULL;           /* where messages to players and spectators are built, one at a time */
+static const char* nextMapPath = NULL;    /* map of the game after this one, NULL if none */
 
 // Function prototypes
-void parseArgs(const int argc, const char* argv[], int* seed);
-static gamestate_t* game_init(FILE* mapfile);
+void parseArgs(const int argc, const char* argv[], options_t* options);
+static gamestate_t* game_init(grid_t* grid, const options_t* options);
 static void game_close(gamestate_t* gameState);
 void handleInput(void* arg);
 char** tokenize(char* message);
 void deleteTokens(char** parsedMessage);
 bool handleMessage(void* arg, const addr_t fromAddress, const char* message);
+static bool recordMessage(void* arg, const addr_t fromAddress, const char* message);
 void movePlayer(gamestate_t* gameState, player_t* player, int x, int y);
 static void handlePlayerQuit(gamestate_t* state, addr_t fromAddress);
 static void addSpectatorToGame(gamestate_t* state, addr_t fromAddress);
 static void reportMalformedMessage(addr_t fromAddress, char* givenInput, char* message);
-static int randomInt(int lower, int upper);
 static void handleSpectatorQuit(gamestate_t* state, addr_t fromAddress);
 static bool isGameEnded(gamestate_t* state);
-static void displayForSpectator(gamestate_t* state, spectator_t* spectator);
+static void displayForSpectators(gamestate_t* state);
 static void displayForPlayer(gamestate_t* state, player_t* player);
+static void setPlayerViewport(gamestate_t* state, addr_t fromAddress, char* rows, char* cols);
 static int getRemainingGold(gamestate_t* state);
 static void sendGoldToPlayers(gamestate_t* state);
 static void sendPlayerOK(player_t* player);
-static void sendGoldToSpectator(gamestate_t* state);
+static void sendGoldToSpectators(gamestate_t* state);
+static void sendToSpectators(gamestate_t* state, char* message);
+static void formatGold(msgbuf_t* buf, int collected, int purse, int remaining);
+static double gameTime(void);
+static bool handleTimeout(void* arg);
 static void handleKey(gamestate_t* state, addr_t fromAddress, char pressedKey);
 static void playerPickedUpGold(gamestate_t* state, player_t* player, int justCollectedGold);
+static void sendUpdates(gamestate_t* state);
+static void heardFromPlayer(player_t* player, double now);
+static void sweepIdlePlayers(gamestate_t* state);
 static void endGame(gamestate_t* state);
 
 /**
  * @brief parses arguments
  * 
+ * usage: ./server map seed [--replay file [--transcript file] | --record file]
+ *                           [--gold-policy uniform|balanced|distance]
+ *                           [--gold-total n] [--gold-piles n]
+ *                           [--max-players n] [--spectator-fps n]
+ *                           [--spectator-refresh every|change|delta]
+ *                           [--idle-after secs] [--evict-after secs]
+ *                           [--rotate dir]
+ * 
  * Inputs:
  * @param argc: # of command line arguments
  * @param argv: char* array of command line arguments
+ * @param options: filled in with the parsed options
  */
 void 
-parseArgs(const int argc, const char* argv[], int* seed)
+parseArgs(const int argc, const char* argv[], options_t* options)
 {
-  // Check for illegal # of arguments
-  if(argc != 3){
+  // Check for illegal # of arguments: map, seed, then flag/value pairs
+  if(argc < 3 || (argc - 3) % 2 != 0){
     flog_v(stderr, "Illegal number of arguments...\n");
     exit(1);
   }
@@ -84,8 +134,21 @@ parseArgs(const int argc, const char* argv[], int* seed)
     }
   }
 
-  // Set seed value
-  *seed = atoi(argv[2]);
+  // Set map and seed values
+  options->mapFile = argv[1];
+  options->seed = atoi(argv[2]);
+  options->replayFile = NULL;
+  options->recordFile = NULL;
+  options->transcriptFile = NULL;
+  options->goldPolicy = GOLD_UNIFORM;
+  options->goldTotal = GoldTotal;
+  options->goldPiles = GoldDefaultNumPiles;
+  options->maxPlayers = MaxPlayers;
+  options->spectatorFPS = 0;
+  options->spectatorRefresh = SPECTATOR_EVERY;
+  options->idleAfter = IdleSeconds;
+  options->evictAfter = EvictSeconds;
+  options->rotateDir = NULL;
 
   // Try to open map file
   FILE* fp;
@@ -94,38 +157,143 @@ parseArgs(const int argc, const char* argv[], int* seed)
     exit(1);
   }
   fclose(fp);
+
+  // Optional flags, each followed by its value
+  for(int i = 3; i < argc; i += 2){
+    const char* flag = argv[i];
+    const char* value = argv[i + 1];
+
+    if(strcmp(flag, "--replay") == 0){
+      options->replayFile = value;
+    }else if(strcmp(flag, "--record") == 0){
+      options->recordFile = value;
+    }else if(strcmp(flag, "--transcript") == 0){
+      options->transcriptFile = value;
+    }else if(strcmp(flag, "--gold-policy") == 0){
+      if(!gold_parsePolicy(value, &options->goldPolicy)){
+        flog_v(stderr, "Invalid gold policy...\n");
+        exit(1);
+      }
+    }else if(strcmp(flag, "--gold-total") == 0){
+      options->goldTotal = atoi(value);
+    }else if(strcmp(flag, "--gold-piles") == 0){
+      options->goldPiles = atoi(value);
+    }else if(strcmp(flag, "--max-players") == 0){
+      if((options->maxPlayers = atoi(value)) < 1){
+        flog_v(stderr, "Invalid maximum number of players...\n");
+        exit(1);
+      }
+    }else if(strcmp(flag, "--spectator-fps") == 0){
+      if((options->spectatorFPS = atoi(value)) < 0){
+        flog_v(stderr, "Invalid spectator frame rate...\n");
+        exit(1);
+      }
+    }else if(strcmp(flag, "--idle-after") == 0){
+      if((options->idleAfter = atoi(value)) < 0){
+        flog_v(stderr, "Invalid idle time...\n");
+        exit(1);
+      }
+    }else if(strcmp(flag, "--evict-after") == 0){
+      if((options->evictAfter = atoi(value)) < 0){
+        flog_v(stderr, "Invalid eviction time...\n");
+        exit(1);
+      }
+    }else if(strcmp(flag, "--rotate") == 0){
+      options->rotateDir = value;
+    }else if(strcmp(flag, "--spectator-refresh") == 0){
+      if(!spectator_parseRefresh(value, &options->spectatorRefresh)){
+        flog_v(stderr, "Invalid spectator refresh policy...\n");
+        exit(1);
+      }
+    }else{
+      flog_v(stderr, "Unknown option...\n");
+      exit(1);
+    }
+  }
+
+  // Every pile must hold at least one nugget
+  if(options->goldPiles < 1 || options->goldPiles > options->goldTotal){
+    flog_v(stderr, "Number of gold piles must be between 1 and the gold total...\n");
+    exit(1);
+  }
+
+  // Can't replay and record at once
+  if(options->replayFile != NULL && options->recordFile != NULL){
+    flog_v(stderr, "Cannot both replay and record...\n");
+    exit(1);
+  }
+
+  // Only a replay sends its messages to a transcript
+  if(options->transcriptFile != NULL && options->replayFile == NULL){
+    flog_v(stderr, "A transcript can only be kept of a replay...\n");
+    exit(1);
+  }
+
+  // A recording holds one game
+  if(options->rotateDir != NULL && (options->replayFile != NULL || options->recordFile != NULL)){
+    flog_v(stderr, "Cannot rotate maps while replaying or recording...\n");
+    exit(1);
+  }
 }
 
 /**
  * @brief constructor. Creates the gamestate object
  * 
  * Inputs:
- * @param mapFile: a FILE pointer to the opened file containing map data.
+ * @param grid: the grid to play on, from catalog_share();
+ * the gamestate takes it over.
+ * @param options: the parsed options, giving the amount of gold,
+ * the number of piles, how to scatter them, the most players,
+ * and how often to refresh spectators.
  * 
  * Returns:
  * @return gamestate_t*: the initialized game instance.
  * @return NULL: an error occured allocating memory for the gamestate.
  */
 static
-gamestate_t* game_init(FILE* mapFile)
+gamestate_t* game_init(grid_t* grid, const options_t* options)
 {
 
-  if(mapFile == NULL){
+  if(grid == NULL){
     flog_v(stderr, "Unable to open and read map file\n");
     exit(1);
   }
     
-  // Create gamestate pointer and call gamestate_init()
-  gamestate_t* gameState = gamestate_init(mapFile);
+  // Create gamestate pointer and call gamestate_new()
+  gamestate_t* gameState = gamestate_new(grid, options->goldPiles, options->goldTotal,
+                                         options->maxPlayers);
 
-  // Condition: gamestate_init successfully created an object
-  if(gameState == NULL){
-    // If gamestate_init gives a NULL poiter, exit with error
+  // Condition: gamestate_new successfully created an object
+  if(gameState == NULL || gameState->gameGold == NULL){
+    // If gamestate_new gives a NULL poiter, exit with error
     flog_v(stderr, "Unable to allocate space for the game state.\n");
     exit(1);
   }else{
     // Distribute gold throughout the grid
-    gold_distribute(gameState->masterGrid, gameState->gameGold);
+    gold_distribute(gameState->masterGrid, gameState->gameGold, options->goldPolicy);
+
+    // Pace the frames sent to each spectator
+    if(options->spectatorFPS > 0){
+      gameState->spectatorInterval = 1.0 / options->spectatorFPS;
+    }
+    gameState->spectatorRefresh = options->spectatorRefresh;
+
+    // Stop sending to, then evict, players who fall silent
+    gameState->idleAfter = options->idleAfter;
+    gameState->evictAfter = options->evictAfter;
+
+    // Every client is told the same dimensions, so say it once
+    grid_t* masterGrid = gameState->masterGrid;
+    gridMessage = msgbuf_new(32);
+    outbox = msgbuf_new((size_t)masterGrid->rows * (masterGrid->cols + 1) + 32);
+    if(gridMessage == NULL || outbox == NULL){
+      flog_v(stderr, "Unable to allocate space for the game state.\n");
+      exit(1);
+    }
+    msgbuf_append(gridMessage, "GRID ");
+    msgbuf_appendInt(gridMessage, masterGrid->rows);
+    msgbuf_appendChar(gridMessage, ' ');
+    msgbuf_appendInt(gridMessage, masterGrid->cols);
   }
 
   // Return the gamestate object
@@ -149,6 +317,10 @@ game_close(gamestate_t* gameState)
   } else {
     // Close game and free memory
     gamestate_closeGame(gameState);
+    msgbuf_delete(gridMessage);
+    msgbuf_delete(outbox);
+    gridMessage = NULL;
+    outbox = NULL;
   }
 }
 
@@ -171,7 +343,7 @@ tokenize(char* message)
   int pos = 0;
 
   /* allocate memory for char pointers, max = strlen */
-  char** tokens = calloc(strlen(message), sizeof(*tokens));
+  char** tokens = calloc(strlen(message) + 1, sizeof(*tokens));
 
   if (tokens == NULL) {
     return NULL;
@@ -182,7 +354,7 @@ tokenize(char* message)
   /* while next token is not NULL 
      save it and get next token */
   while (token != NULL) {
-    tokens[pos++] = malloc(sizeof(token)+1);
+    tokens[pos++] = malloc(strlen(token)+1);
     strcpy(tokens[pos-1], token);
     token = strtok(NULL, " ");
   }
@@ -233,6 +405,9 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
 
   /* convert arg back to gamestate */
   gamestate_t* state = (gamestate_t*) arg;
+  state->now = gameTime();
+  /* whether the message may change what clients are shown */
+  bool changesGame = false;
   /* get tokens in message */
   char* message_copy = calloc(strlen(message)+1, sizeof(*message_copy));
   strcpy(message_copy, message);
@@ -247,9 +422,8 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
 
     if (numTokens == 0) {
       // Send malformed message back to client / spectator
-      message_send(fromAddress, "ERROR malformed message\n");
+      transport_send(fromAddress, "ERROR malformed message\n");
       flog_v(stderr, "Message detected with ZERO tokens. Stop.\n");
-      free((char*)message);
       free(message_copy);
       free(tokens);
       return false;
@@ -258,7 +432,73 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
     /* run switch statement on first char of first token */
     switch (tokens[0][0])
     {
+      case 'A':
+
+        /* acknowledgement of a numbered message */
+        if (numTokens == 2 && (strcmp(tokens[0], "ACK") == 0) ) {
+          transport_ack(fromAddress, atoi(tokens[1]));
+        }
+        else {
+          reportMalformedMessage(fromAddress, message_copy, "is not a valid acknowledgement.");
+        }
+        break;
+
+      case 'R':
+
+        /* number, and resend until acknowledged, all messages to this client */
+        if (numTokens == 1 && (strcmp(tokens[0], "RELIABLE") == 0) ) {
+          if (!transport_openSession(fromAddress)) {
+            flog_v(stderr, "Unable to open a reliable session.\n");
+          }
+        }
+        else {
+          reportMalformedMessage(fromAddress, message_copy, "is not a valid message.");
+        }
+        break;
+
+      case 'B':
+
+        /* send this client each update's messages in one datagram */
+        if (numTokens == 1 && (strcmp(tokens[0], "BATCH") == 0) ) {
+          if (!transport_setBatching(fromAddress, true)) {
+            flog_v(stderr, "Unable to batch messages for a client.\n");
+          }
+        }
+        else {
+          reportMalformedMessage(fromAddress, message_copy, "is not a valid message.");
+        }
+        break;
+
+      case 'E': {
+
+        /* how the client would like its frames encoded */
+        transport_encoding_t encoding;
+        if (numTokens == 2 && (strcmp(tokens[0], "ENCODING") == 0)
+            && transport_parseEncoding(tokens[1], &encoding) ) {
+          if (!transport_setEncoding(fromAddress, encoding)) {
+            flog_v(stderr, "Unable to set the encoding for a client.\n");
+          }
+        }
+        else {
+          reportMalformedMessage(fromAddress, message_copy, "is not a valid encoding message.");
+        }
+        break;
+      }
+
+      case 'V':
+        changesGame = true;
+
+        /* the size of the player's terminal, to be sent only that much */
+        if (numTokens == 3 && (strcmp(tokens[0], "VIEWPORT") == 0) ) {
+          setPlayerViewport(state, fromAddress, tokens[1], tokens[2]);
+        }
+        else {
+          reportMalformedMessage(fromAddress, message_copy, "is not a valid viewport message.");
+        }
+        break;
+
       case 'K':
+        changesGame = true;
 
         /* handle gameplay keys */
         if (numTokens == 2 && (strcmp(tokens[0], "KEY") == 0) ) {
@@ -271,6 +511,7 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
         break;
 
       case 'S':
+        changesGame = true;
 
         /* add spectator if message checks out*/
         if (numTokens == 1 && (strcmp(tokens[0], "SPECTATE") == 0) ) {
@@ -284,6 +525,7 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
         }
         break;
       case 'Q':
+        changesGame = true;
         /* routine for removing player */
         if (numTokens == 0 && (strcmp(tokens[0], "QUIT") == 0) ) {
 
@@ -307,60 +549,76 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
       case 'P':
         /* routine to add player */
         if (numTokens >= 2 && (strcmp(tokens[0], "PLAY") == 0) ) {
+          changesGame = true;
 
-          /* init grid for player */
-          grid_t* playerGrid = grid_initForPlayer(state->masterGrid);
+          /* turn the player away before allocating anything */
+          if (gamestate_isFull(state)) {
+            transport_send(fromAddress, "QUIT Game is full.");
+            break;
+          }
 
-          /* get number of rows and columns in master grid */
-          int rows = state->masterGrid->rows;
-          int cols = state->masterGrid->cols;
+          /* init view for player */
+          grid_view_t* playerView = grid_initForPlayer(state->masterGrid);
+          if (playerView == NULL) {
+            flog_v(stderr, "Unable to allocate a view for a new player.\n");
+            break;
+          }
 
           /* generate letter for player */
-          char letter = 'A' + state->players_seen;
+          char letter = gamestate_nextLabel(state);
 
           /* get full player name */
-          char playerName[MaxNameLength];
+          char playerName[MaxNameLength + 1];
+          playerName[0] = '\0';
           for (int i = 1; i < numTokens; i++) {
             char *temp = tokens[i];
-            if(i == 1){
-              strcpy(playerName, temp);
-            }else{
-              strcat(playerName, temp);
-            }
+            strncat(playerName, temp, MaxNameLength - strlen(playerName));
           }
 
-          /* generate random x,y values 
-             and check for validity 
-             until valid point is found */
-          int x = randomInt(1, cols);
-          int y = randomInt(1, rows);
-
-          while (! grid_isSpace(state->masterGrid, x, y)) {
-            x = randomInt(1, cols);
-            y = randomInt(1, rows);
+          /* pick a random room floor cell
+             with neither gold nor a player on it */
+          int x, y;
+          if (! grid_randomFreeCell(state->masterGrid, &x, &y)) {
+            grid_deleteView(playerView);
+            transport_send(fromAddress, "QUIT No room left to join the game.");
+            break;
           }
 
           /* create player */
-          player_t* newPlayer = player_new(letter, playerName, fromAddress, x, y, playerGrid);
+          player_t* newPlayer = player_new(letter, playerName, fromAddress, x, y, playerView);
 
           /* if player created successfully,
              add to gamestate */
-          if (newPlayer != NULL) {
-            gamestate_addPlayer(state, newPlayer);
-            char initMessage[100];
-            sprintf(initMessage, "GRID %d %d", rows, cols);
-            player_send(newPlayer, initMessage);
+          if (newPlayer != NULL && gamestate_addPlayer(state, newPlayer)) {
+            grid_claimCell(state->masterGrid, x, y);
+            gamestate_touchCell(state, x, y);
+            heardFromPlayer(newPlayer, state->now);
+            player_send(newPlayer, gridMessage->text);
             sendPlayerOK(newPlayer);
           }
 
           /* if player creation failed, 
-             delete player grid
+             delete player view
              print error flag */
+          else if (newPlayer != NULL) {
+            player_delete(newPlayer);
+            transport_send(fromAddress, "QUIT Game is full.");
+          }
           else {
-            grid_delete(playerGrid);
+            grid_deleteView(playerView);
             reportMalformedMessage(fromAddress, message_copy, "is not a valid player message.");
           }
         }
+
+        /* heartbeat: a player with nothing to say stays in the game */
+        else if (numTokens == 1 && (strcmp(tokens[0], "PING") == 0) ) {
+          player_t* player = gamestate_findPlayerByAddress(state, fromAddress);
+          if (player_isActive(player)) {
+            changesGame = player->isIdle;   /* it is due a frame again */
+            heardFromPlayer(player, state->now);
+          }
+          transport_send(fromAddress, "PONG");
+        }
         else {
           reportMalformedMessage(fromAddress, message_copy, "is not a valid message.");
         }
@@ -372,21 +630,21 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
     free(message_copy);
   }
 
-  // Send updated game state to spectator
-  displayForSpectator(state, state->spectator);
+  // Only game messages change what clients are shown: messages about
+  // the transport (ACK, RELIABLE, BATCH, ENCODING, PING) are answered
+  // with no frames, or a reliable client acknowledging each frame
+  // would be sent another, without end
+  if(changesGame){
+    // Stop sending to players who fell silent, and evict the long gone
+    sweepIdlePlayers(state);
 
-  // Send updated game state to all players
-  int numClients = state->players_seen;
-  player_t** clients = state->players;
-  for(int i = 0; i < numClients; i++){
-    displayForPlayer(state, clients[i]);
+    // Send what changed to every client
+    sendUpdates(state);
   }
+  transport_flush();
 
-  // Send gold to players
-  sendGoldToPlayers(state);
-
-  // Send gold to spectator
-  sendGoldToSpectator(state);
+  // Resend what clients in reliable sessions have not acknowledged
+  transport_retransmit(state->now);
 
   // Check if game is ended
   if(!isGameEnded(state)){
@@ -394,12 +652,112 @@ handleMessage(void* arg, const addr_t fromAddress, const char* message)
   }else{
     // Do things for when game is over
 	endGame(state);
+    transport_flush();
     return true;
   }
 }
 
 /**************** Static Functions ******************/
 
+/**
+ * @brief Message callback used when recording: appends the message
+ * to the recording, then hands it to handleMessage.
+ * 
+ * Inputs:
+ * @param arg: a pointer to the server's `gamestate` object
+ * @param fromAddress: an addr_t representing the sending device
+ * @param message: a string with the message text from the sender
+ */
+static bool
+recordMessage(void* arg, const addr_t fromAddress, const char* message)
+{
+  replay_record(recordFP, gameTime(), fromAddress, message);
+
+  return handleMessage(arg, fromAddress, message);
+}
+
+/**
+ * @brief Sends every client what changed: frames to spectators,
+ * frames to players still in the game, and not idle, whose room
+ * or passage changed since their last frame, and GOLD to those
+ * whose figures changed.
+ * 
+ * Inputs:
+ * @param state: the server's gamestate
+ */
+static void
+sendUpdates(gamestate_t* state){
+  // Send updated game state to spectators
+  displayForSpectators(state);
+
+  // Work out who sees whom, once for all players
+  gamestate_updateVisibility(state);
+
+  // Send updated game state to players still in the game
+  // whose room or passage changed since their last frame
+  int numClients = state->players_seen;
+  player_t** clients = state->players;
+  for(int i = 0; i < numClients; i++){
+    if(player_isActive(clients[i]) && !clients[i]->isIdle
+       && gamestate_needsDisplay(state, clients[i])){
+      displayForPlayer(state, clients[i]);
+    }
+  }
+
+  // Send gold to players and spectators whose figures changed
+  sendGoldToPlayers(state);
+  sendGoldToSpectators(state);
+}
+
+/**
+ * @brief Notes that a player was heard from. A player who was idle
+ * is sent a fresh frame and GOLD with the next update.
+ * 
+ * Inputs:
+ * @param player: the player
+ * @param now: the game time
+ */
+static void
+heardFromPlayer(player_t* player, double now){
+  player->lastHeard = now;
+  if(player->isIdle){
+    player->isIdle = false;
+    player->shownSegment = -1;
+    player->shownPurse = -1;
+  }
+}
+
+/**
+ * @brief Marks idle the players silent for idleAfter seconds,
+ * so that they are sent nothing, and evicts those silent for
+ * evictAfter seconds, as if they had quit, freeing their slot.
+ * Called only while handling a game message, at its timestamp, never
+ * from a timeout: a recording holds only messages, so this way
+ * a replay idles and evicts the same players at the same points.
+ * 
+ * Inputs:
+ * @param state: the server's gamestate
+ */
+static void
+sweepIdlePlayers(gamestate_t* state){
+  for(int i = 0; i < state->players_seen; i++){
+    player_t* player = state->players[i];
+    if(!player_isActive(player)){
+      continue;
+    }
+
+    double silence = state->now - player->lastHeard;
+    if(state->evictAfter > 0 && silence >= state->evictAfter){
+      player_leave(player, PLAYER_DISCONNECTED);
+      grid_releaseCell(state->masterGrid, player->x, player->y);
+      gamestate_touchCell(state, player->x, player->y);
+      player_send(player, "QUIT You were idle too long.");
+    }else if(state->idleAfter > 0 && silence >= state->idleAfter){
+      player->isIdle = true;
+    }
+  }
+}
+
 /**
  * @brief Updates player in gamestate and sends GOLD messages
  * 
@@ -414,37 +772,12 @@ playerPickedUpGold(gamestate_t* state, player_t* player, int justCollectedGold){
   int goldLeftInGame = getRemainingGold(state);
 
   // Format individual GOLD message and send to player
-  char goldCollectedMessage[50];
-  sprintf(goldCollectedMessage, "GOLD %d %d %d", justCollectedGold, currentPlayerGold, goldLeftInGame);
-  player_send(player, goldCollectedMessage);
+  formatGold(outbox, justCollectedGold, currentPlayerGold, goldLeftInGame);
+  player_send(player, outbox->text);
+  player->shownPurse = currentPlayerGold;
+  player->shownRemaining = goldLeftInGame;
 
-  // Send GOLD messages to all players and spectators
-  sendGoldToPlayers(state);
-  sendGoldToSpectator(state);
-}
-
-/**
- * @brief: Function to generate a number within a range.
- * calls rand() to generate a random number 
- * then bounds it to expectate range using mod operator.
- * This is handy because rand() doesn't take any arguments
- * and generates unbounded values
- * 
- * @param lower: lower bound, inclusive
- * @param upper: upper bound, exclusive
- * @return int: a random value between the lower and upper bound.
- */
-static int
-randomInt(int lower, int upper)
-{
-  if (lower < upper) {
-    int num = lower;
-    int randomNumber = rand();
-    num += randomNumber % (upper - lower);
-    return num;
-  }
-  flog_v(stderr, "Attempt to generate a number with invalid bounds. Stop.\n");
-  return -1;
+  // Everyone else hears of the nuggets left once this message is handled
 }
 
 /**
@@ -458,18 +791,19 @@ randomInt(int lower, int upper)
 static void
 addSpectatorToGame(gamestate_t* state, addr_t fromAddress){
   /* add spectator to game */
-  gamestate_addSpectator(state, fromAddress);
-
-  /* get number of rows, columns in grid */
-  int rows = state->masterGrid->rows;
-  int cols = state->masterGrid->cols;
+  spectator_t* spectator = gamestate_addSpectator(state, fromAddress);
+  if (spectator == NULL) {
+    return;
+  }
 
-  /* generate init message */
-  char initMessage[100];                            /* No need to malloc; only used once */
-  sprintf(initMessage, "GRID %d %d", rows, cols);
+  /* its first frame goes out, in full, with this message's update */
+  spectator->lastFrameTime = 0;
+  spectator->frameVersion = -1;
+  free(spectator->frame);
+  spectator->frame = NULL;
 
   /* send init message to spectator */
-  spectator_send(state->spectator, initMessage);
+  spectator_send(spectator, gridMessage->text);
 }
 
 /**
@@ -483,7 +817,7 @@ addSpectatorToGame(gamestate_t* state, addr_t fromAddress){
  */
 static void
 reportMalformedMessage(addr_t fromAddress, char* givenInput, char* message){
-  message_send(fromAddress, "ERROR malformed message\n");
+  transport_send(fromAddress, "ERROR malformed message\n");
 
   char* completeErrorMessage = calloc(1, strlen(givenInput) + strlen(message) + 10);
   sprintf(completeErrorMessage, "'%s' %s \n", givenInput, message);
@@ -504,17 +838,13 @@ reportMalformedMessage(addr_t fromAddress, char* givenInput, char* message){
 static void
 handleSpectatorQuit(gamestate_t* state, addr_t fromAddress){
   /* get spectator */
-  spectator_t* spectator = state->spectator;
+  spectator_t* spectator = gamestate_findSpectatorByAddress(state, fromAddress);
 
   /* send QUIT message to spectator */
   spectator_send(spectator, "QUIT Thank you for watching!");
 
-  /* delete spectator */
-  spectator_delete(spectator);
-
-  /* reset state spectator pointer to NULL 
-     (just so we don't get any surprises) */
-  state->spectator = NULL;
+  /* remove and delete spectator */
+  gamestate_removeSpectator(state, spectator);
 }
 
 /**
@@ -532,7 +862,7 @@ handleKey(gamestate_t* state, addr_t fromAddress, char pressedKey){
 	grid_t* Grid = state->masterGrid;
 
 	// If cant find player but can find spectator
-	if (player == NULL &&  message_eqAddr(fromAddress, state->spectator->address) ){
+	if (player == NULL &&  gamestate_isSpectator(state, fromAddress) ){
 		flog_v(stderr, "Couldn't find a matching player for key press\n");
     if (pressedKey == 'Q'){
       handleSpectatorQuit(state, fromAddress);
@@ -540,6 +870,13 @@ handleKey(gamestate_t* state, addr_t fromAddress, char pressedKey){
 		return;
 	}
 
+	// If the key came from neither a player nor the spectator,
+	// or from a player who has quit, ignore it
+	if (!player_isActive(player)) {
+		return;
+	}
+	heardFromPlayer(player, state->now);
+
     switch (pressedKey) {
     case 'l': 
         movePlayer(state, player, player->x+1, player->y);
@@ -624,14 +961,16 @@ static void
 handlePlayerQuit(gamestate_t* state, addr_t fromAddress){
   /* We don't actually delete the player from the game 
     because we need to keep their information
-    until end of game. */
+    until end of game; player_leave() keeps just that. */
 
   // Search for player with matching address in gamestate
   player_t* player = gamestate_findPlayerByAddress(state, fromAddress);
 
   // If we find a matching player in the game, let them quit
-  if (player != NULL) {
-    player->hasQuit = true;
+  if (player_isActive(player)) {
+    player_leave(player, PLAYER_QUIT);
+    grid_releaseCell(state->masterGrid, player->x, player->y);
+    gamestate_touchCell(state, player->x, player->y);
     player_send(player, "QUIT Thank you for playing!");
   }
 
@@ -644,29 +983,64 @@ handlePlayerQuit(gamestate_t* state, addr_t fromAddress){
 }
 
 /**
- * @brief Sends the DISPLAY message to the spectator
+ * @brief Sends a frame to every spectator due one.
+ * A spectator is due once spectatorInterval has passed since its
+ * last frame and, unless refreshing every time, the frame has changed
+ * since. The master grid is rendered once, and only if some spectator
+ * may be due, whatever the number of spectators.
  * 
  * Inputs:
  * @param state: the server's gamestate
- * @param spectator: a pointer to the spectator to send to
  */
 static void
-displayForSpectator(gamestate_t* state, spectator_t* spectator){
-  // Convert master grid to a string
+displayForSpectators(gamestate_t* state){
+  // Find whether any spectator is due a frame, by time
+  int due = 0;
+  for(int i = 0; i < state->numSpectators; i++){
+    if(state->now - state->spectators[i]->lastFrameTime >= state->spectatorInterval){
+      due++;
+    }
+  }
+  if(due == 0){
+    return;
+  }
+
+  // Render the master grid straight after the message header
   grid_t* entireGrid = state->masterGrid;
-  char* masterGridAsString = grid_toString(state, entireGrid);
-  
-  // Create message header
-  char* messageHeader = malloc((sizeof(char) * strlen(masterGridAsString)) + 10 );
-  
-  // Concatenate and send message
-  strcpy(messageHeader, "DISPLAY\n");
-  strcat(messageHeader, masterGridAsString);
-  spectator_send(spectator, messageHeader);
-
-  // Free created memory
-  free(messageHeader);
-  free(masterGridAsString);
+  msgbuf_t* frame = outbox;
+  msgbuf_clear(frame);
+  msgbuf_append(frame, "DISPLAY\n");
+  if(!msgbuf_reserve(frame, (size_t)entireGrid->rows * (entireGrid->cols + 1))){
+    return;
+  }
+  frame->length += grid_write(state, entireGrid, frame->text + frame->length);
+
+  // Keep the frame, under a new version if it changed
+  if(state->spectatorFrame == NULL || strcmp(state->spectatorFrame, frame->text) != 0){
+    char* kept = malloc(frame->length + 1);
+    if(kept == NULL){
+      return;
+    }
+    memcpy(kept, frame->text, frame->length + 1);
+    free(state->spectatorFrame);
+    state->spectatorFrame = kept;
+    state->spectatorFrameVersion++;
+  }
+
+  // Send it to those due
+  for(int i = 0; i < state->numSpectators; i++){
+    spectator_t* spectator = state->spectators[i];
+    if(state->now - spectator->lastFrameTime < state->spectatorInterval){
+      continue;
+    }
+    if(state->spectatorRefresh != SPECTATOR_EVERY
+       && spectator->frameVersion == state->spectatorFrameVersion){
+      continue;
+    }
+    spectator_sendFrame(spectator, state->spectatorFrame,
+                        state->spectatorFrameVersion, state->spectatorRefresh);
+    spectator->lastFrameTime = state->now;
+  }
 }
 
 /**
@@ -685,23 +1059,75 @@ displayForPlayer(gamestate_t* state, player_t* player){
   grid_t* entireGrid = state->masterGrid;
   grid_calculateVisibility(entireGrid, player);
 
-  // Covert visible grid to string
-  char* playerGridAsString = grid_toStringForPlayer(state, player);
-  
-  // Create message header
-  char* messageHeader = malloc((sizeof(char) * strlen(playerGridAsString)) + 10 );
-  strcpy(messageHeader, "DISPLAY\n");
-
-  /* TODO: Make a playerSpecific grid_toString function that takes in
-  * the game state so that player and gold visibility can be accounted for
-  * in the final string.
-  */ 
-  strcat(messageHeader, playerGridAsString);
-  player_send(player, messageHeader);
-
-  // Free created memory
-  free(messageHeader);
-  free(playerGridAsString);
+  // Build the frame in the shared outbox, sized for a whole map;
+  // it is sent straight away, so every player's frame can go there
+  msgbuf_t* frame = outbox;
+  msgbuf_clear(frame);
+
+  // Send just the viewport, if the player has one
+  if(player->viewRows > 0){
+    int rows = player->viewRows, cols = player->viewCols, top, left;
+    grid_fitWindow(entireGrid, player, &rows, &cols, &top, &left);
+    msgbuf_append(frame, "WINDOW ");
+    msgbuf_appendInt(frame, top);
+    msgbuf_appendChar(frame, ' ');
+    msgbuf_appendInt(frame, left);
+    msgbuf_appendChar(frame, '\n');
+    if(!msgbuf_reserve(frame, (size_t)rows * (cols + 1))){
+      return;
+    }
+    frame->length += grid_writeWindowForPlayer(state, player, rows, cols, top, left,
+                                               frame->text + frame->length);
+  }else{
+    // Render the player's view straight after the message header
+    msgbuf_append(frame, "DISPLAY\n");
+    if(!msgbuf_reserve(frame, (size_t)entireGrid->rows * (entireGrid->cols + 1))){
+      return;
+    }
+    frame->length += grid_writeForPlayer(state, player, frame->text + frame->length);
+  }
+  player_send(player, frame->text);
+  gamestate_markDisplayed(state, player);
+}
+
+/**
+ * @brief sets the size of a player's viewport: from now on the player
+ * is sent WINDOW frames of that size, centred on them, rather than
+ * DISPLAY frames of the whole map. A size of 0 0 goes back to DISPLAY.
+ * 
+ * Inputs:
+ * @param state: the server's gamestate
+ * @param fromAddress: the address of the player
+ * @param rows: the height of the viewport, as sent
+ * @param cols: the width of the viewport, as sent
+ */
+static void
+setPlayerViewport(gamestate_t* state, addr_t fromAddress, char* rows, char* cols){
+  player_t* player = gamestate_findPlayerByAddress(state, fromAddress);
+  if(!player_isActive(player)){
+    transport_send(fromAddress, "ERROR malformed message\n");
+    flog_v(stderr, "Viewport set by a client that is not playing.\n");
+    return;
+  }
+  heardFromPlayer(player, state->now);
+
+  // Both sizes must be numbers, and both zero or both positive
+  char* rowsEnd;
+  char* colsEnd;
+  long viewRows = strtol(rows, &rowsEnd, 10);
+  long viewCols = strtol(cols, &colsEnd, 10);
+  if(*rowsEnd != '\0' || *colsEnd != '\0' || viewRows < 0 || viewCols < 0
+     || (viewRows == 0) != (viewCols == 0) || viewRows > 10000 || viewCols > 10000){
+    transport_send(fromAddress, "ERROR malformed message\n");
+    flog_v(stderr, "Invalid viewport size.\n");
+    return;
+  }
+
+  player->viewRows = viewRows;
+  player->viewCols = viewCols;
+
+  // Send a frame of the new size with this update
+  player->shownSegment = -1;
 }
 
 static bool
@@ -710,12 +1136,11 @@ isGameEnded(gamestate_t* state){
   gold_t* gold_from_state = state->gameGold;
   
   // See if we have collected all gold piles
-  // (if index == num_gold_piles)
-  int index = gold_from_state->index;
+  int collected = gold_from_state->numCollected;
   int num_gold_piles = gold_from_state->numPiles;
 
 
-  if(index >= num_gold_piles){
+  if(collected >= num_gold_piles){
     return true;
   } else{
     return false;
@@ -734,16 +1159,12 @@ void movePlayer(gamestate_t* gameState, player_t* player, int x, int y){
 
 	grid_t* Grid = gameState->masterGrid;
  	gold_t* gameGold = gameState->gameGold;
-	
-  	char** player_grid = player->grid->g;
-	char** master_grid = Grid->g;
-	int* gold_array = gameGold->goldCounter;
 
 	player_t **players = gameState->players;
 	player_t* otherPlayer = NULL;
 	for(int i = 0; i < gameState->players_seen;i++){
 		otherPlayer = players[i];
-		if (otherPlayer->x == x && otherPlayer->y == y && otherPlayer->letter != player->letter){
+		if (otherPlayer->x == x && otherPlayer->y == y && otherPlayer != player && player_isActive(otherPlayer)){
 			break;
 		} else{
 			otherPlayer = NULL;
@@ -752,31 +1173,31 @@ void movePlayer(gamestate_t* gameState, player_t* player, int x, int y){
 
 
 	if(!grid_isWall(Grid, x, y)){
+		// Both ends of the move change for those who can see them
+		gamestate_touchCell(gameState, player->x, player->y);
+		gamestate_touchCell(gameState, x, y);
+
 		if (grid_isGold(Grid, x, y)){
-			player_grid[player->y][player->x] = '.';
-			master_grid[player->y][player->x] = '.';
+			// The cell left is as it was; it may be a passage
+			grid_viewCell(Grid, player->view, player->x, player->y);
+			grid_releaseCell(Grid, player->x, player->y);
 
 			player->x = x;
 			player->y = y;
 			
-			player->gold += gold_array[gameGold->index];
-			int goldJustCollected = gold_array[gameGold->index];
+			int goldJustCollected = gold_collect(gameGold, player, x, y);
 			playerPickedUpGold(gameState, player, goldJustCollected);
-
-			gameGold->index += 1;
 				
-			master_grid[player->y][player->x] = '.';
-      player_grid[player->y][player->x] = '.';
+			grid_setCell(Grid, player->x, player->y, '.');
+			grid_viewCell(Grid, player->view, player->x, player->y);
 
 		}else if(otherPlayer != NULL){
 
-			char** otherPlayer_grid = otherPlayer->grid->g;
-
 			int tempx = player->x;
 			int tempy = player->y;
 
-			player_grid[player->y][player->x] = master_grid[player->y][player->x];
-			otherPlayer_grid[otherPlayer->y][otherPlayer->x] = master_grid[otherPlayer->y][otherPlayer->x];
+			grid_viewCell(Grid, player->view, player->x, player->y);
+			grid_viewCell(Grid, otherPlayer->view, otherPlayer->x, otherPlayer->y);
 
 			player->y = otherPlayer->y;
 			player->x = otherPlayer->x;
@@ -785,7 +1206,9 @@ void movePlayer(gamestate_t* gameState, player_t* player, int x, int y){
 			otherPlayer->x = tempx;
 			
 		}else{
-      player_grid[y][x] = master_grid[y][x];
+			grid_viewCell(Grid, player->view, x, y);
+			grid_releaseCell(Grid, player->x, player->y);
+			grid_claimCell(Grid, x, y);
 			player->x = x;
 			player->y = y;
 		}
@@ -797,8 +1220,9 @@ static void endGame(gamestate_t* state){
   player_t** allPlayers = state->players;
   int numPlayers = state->players_seen;
 
-  // Allocate space for message to players
-  char* endMessage = calloc(1+numPlayers, (MaxNameLength*sizeof(char)) + 20);
+  // Allocate space for message to players, and the next game's map
+  size_t nextLength = nextMapPath != NULL ? strlen(nextMapPath) + 40 : 0;
+  char* endMessage = calloc(1, (1+numPlayers) * ((MaxNameLength*sizeof(char)) + 20) + nextLength);
 
   // Loop over every player and add info to leaderboard
   strcpy(endMessage, "QUIT GAME OVER:\n");
@@ -813,81 +1237,180 @@ static void endGame(gamestate_t* state){
     free(tempBuffer);
   }
 
+  // When rotating, tell everyone where to join next
+  if(nextMapPath != NULL){
+    strcat(endMessage, "Next game on ");
+    strcat(endMessage, nextMapPath);
+    strcat(endMessage, "; join again to play.\n");
+  }
+
   // Send message to all players and the specatator and then free them
   for(int i = 0; i < numPlayers; i++){
     player_send(allPlayers[i], endMessage);
   }
 
-  spectator_send(state->spectator, endMessage);
+  sendToSpectators(state, endMessage);
 
   // Free ending message
   free(endMessage);
 }
 
+/**
+ * @brief sends GOLD to every player still in the game, and not idle,
+ * whose purse, or the nuggets left, changed since the last GOLD it was sent.
+ * 
+ * Inputs:
+ * @param state: the server's gamestate
+ */
 static void
 sendGoldToPlayers(gamestate_t* state){
   // Loop over every player
   player_t** allPlayers = state->players;
   int numPlayers = state->players_seen;
+  int goldLeftInGame = getRemainingGold(state);
 
   for(int i = 0; i < numPlayers; i++){
-    // Get n, p and r
-    int currentPlayerGold = allPlayers[i]->gold;
+    player_t* player = allPlayers[i];
+
+    // Get n, p and r; skip the player if it already has them
+    int currentPlayerGold = player->gold;
     int justCollectedGold = 0;
-    int goldLeftInGame = getRemainingGold(state);
+    if(!player_isActive(player) || player->isIdle
+       || (player->shownPurse == currentPlayerGold
+           && player->shownRemaining == goldLeftInGame)){
+      continue;
+    }
 
     // Format and send message
-    char* goldMessage = malloc(sizeof(char) * 100);
-    sprintf(goldMessage,
-    "GOLD %d %d %d", justCollectedGold, currentPlayerGold, goldLeftInGame);
-
-    player_send(allPlayers[i], goldMessage);
-
-    // Free used memory
-    free(goldMessage);
+    formatGold(outbox, justCollectedGold, currentPlayerGold, goldLeftInGame);
+    player_send(player, outbox->text);
+    player->shownPurse = currentPlayerGold;
+    player->shownRemaining = goldLeftInGame;
   }
 }
 
+/**
+ * @brief sends GOLD to every spectator not yet told
+ * the nuggets left.
+ * 
+ * Inputs:
+ * @param state: the server's gamestate
+ */
 static void
-sendGoldToSpectator(gamestate_t* state){
-  // Get spectator object
-  spectator_t* spectator = state->spectator;
-
+sendGoldToSpectators(gamestate_t* state){
   // Get numbers for amnt of gold
   int currentGold = 0;
   int justCollectedGold = 0;
   int goldLeftInGame = getRemainingGold(state);
 
-  // Create gold message
-  char* goldMessage = malloc(sizeof(char) * 100);
-  sprintf(goldMessage, "GOLD %d %d %d", currentGold, justCollectedGold, goldLeftInGame);
-  
-  // Send gold message
-  spectator_send(spectator, goldMessage);
+  // Create gold message, built only if someone needs it
+  bool built = false;
+  for(int i = 0; i < state->numSpectators; i++){
+    spectator_t* spectator = state->spectators[i];
+    if(spectator->shownRemaining == goldLeftInGame){
+      continue;
+    }
+    if(!built){
+      formatGold(outbox, currentGold, justCollectedGold, goldLeftInGame);
+      built = true;
+    }
+    spectator_send(spectator, outbox->text);
+    spectator->shownRemaining = goldLeftInGame;
+  }
+}
 
-  //Free created memory
-  free(goldMessage);
+/**
+ * @brief builds a GOLD message in a buffer, replacing its contents.
+ * 
+ * Inputs:
+ * @param buf: the buffer, e.g. the outbox
+ * @param collected: n, the nuggets just collected
+ * @param purse: p, the nuggets in the recipient's purse
+ * @param remaining: r, the nuggets left to find
+ */
+static void
+formatGold(msgbuf_t* buf, int collected, int purse, int remaining){
+  msgbuf_clear(buf);
+  msgbuf_append(buf, "GOLD ");
+  msgbuf_appendInt(buf, collected);
+  msgbuf_appendChar(buf, ' ');
+  msgbuf_appendInt(buf, purse);
+  msgbuf_appendChar(buf, ' ');
+  msgbuf_appendInt(buf, remaining);
 }
 
-static int
-getRemainingGold(gamestate_t* state){
-  gold_t* gamestateGold = state->gameGold;
-  int goldLeft = 0;
-  int currentIndex = gamestateGold->index;
+/**
+ * @brief sends one message to every spectator.
+ * 
+ * Inputs:
+ * @param state: the server's gamestate
+ * @param message: the message to send
+ */
+static void
+sendToSpectators(gamestate_t* state, char* message){
+  for(int i = 0; i < state->numSpectators; i++){
+    spectator_send(state->spectators[i], message);
+  }
+}
 
-  for(int i = currentIndex; i < gamestateGold->numPiles; i++){
-    goldLeft += gamestateGold->goldCounter[i];
+/**
+ * @brief Timeout callback for the message loop: sends spectators
+ * any frame held back by their frame rate, so that they catch up
+ * even when no more messages arrive, and resends messages that
+ * clients in reliable sessions have not acknowledged.
+ * It changes nothing in the game (players fall idle, or are evicted,
+ * only when a message is handled; see sweepIdlePlayers()).
+ * 
+ * Inputs:
+ * @param arg: a pointer to the server's `gamestate` object
+ * 
+ * Returns:
+ * @return false: keep looping.
+ */
+static bool
+handleTimeout(void* arg){
+  gamestate_t* state = (gamestate_t*) arg;
+  state->now = gameTime();
+  if(state->spectatorInterval > 0){
+    displayForSpectators(state);
   }
+  transport_flush();
+  transport_retransmit(state->now);
+  return false;
+}
 
-  return goldLeft;
+/**
+ * @brief the game clock: the timestamp of the message being replayed,
+ * if replaying, so that a replay paces spectators as the game did;
+ * otherwise the wall-clock time.
+ * 
+ * Returns:
+ * @return double: the time in seconds.
+ */
+static double
+gameTime(void){
+  double replayed = replay_time();
+  if(replayed > 0){
+    return replayed;
+  }
+
+  struct timespec now;
+  timespec_get(&now, TIME_UTC);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int
+getRemainingGold(gamestate_t* state){
+  // The gold module keeps a running total
+  return state->gameGold->remaining;
 }
 
 
 static void 
 sendPlayerOK(player_t* player){
-  // Generate message from player data
-  char okMessage[10];
-  sprintf(okMessage, "OK %c", player->letter);
+  // Fill the player's letter into the message
+  char okMessage[] = "OK ?";
+  okMessage[3] = player->letter;
 
   // Send message to player
   player_send(player, okMessage);
@@ -897,18 +1420,75 @@ int
 main(const int argc, const char* argv[])
 {
   // Parse arguments  and use seed value
-  int seed = 0;
-  parseArgs(argc, argv, &seed);
-  srand(seed);
+  options_t options;
+  parseArgs(argc, argv, &options);
+  srand(options.seed);
+
+  // Load every map to be played, once, before the first game
+  catalog_t* maps = catalog_new();
+  if(maps == NULL){
+    flog_v(stderr, "Unable to allocate space for the map catalog.\n");
+    exit(1);
+  }
+  if(options.rotateDir != NULL && catalog_addDirectory(maps, options.rotateDir) < 0){
+    flog_v(stderr, "Could not read map directory...\n");
+    exit(1);
+  }
+  int currentMap = catalog_find(maps, options.mapFile);
+  if(currentMap < 0){
+    flog_v(stderr, "Could not load map...\n");
+    exit(1);
+  }
 
-  // Open and close map file and init gamestate object
-  FILE* fp  = fopen(argv[1], "r");
-  gamestate_t* gs = game_init(fp);
+  // Init gamestate object on the first map
+  gamestate_t* gs = game_init(catalog_share(maps, currentMap), &options);
   if(gs == NULL){
     printf("NULL GAMESTATE!\n");
     exit(1);
   }
-  fclose(fp);
+
+  // Replay a recording instead of listening on the network
+  if(options.replayFile != NULL){
+    FILE* replayFP = fopen(options.replayFile, "r");
+    if(replayFP == NULL){
+      flog_v(stderr, "Could not open replay file...\n");
+      exit(1);
+    }
+    // Drop what the game sends, or write it to the transcript
+    FILE* transcriptFP = NULL;
+    if(options.transcriptFile != NULL){
+      if((transcriptFP = fopen(options.transcriptFile, "w")) == NULL){
+        flog_v(stderr, "Could not open transcript file...\n");
+        exit(1);
+      }
+      transport_setSink(transport_print, transcriptFP);
+    }else{
+      transport_setSink(transport_discard, NULL);
+    }
+    replay_loop(replayFP, gs, handleMessage);
+    fclose(replayFP);
+
+    long messagesSent, bytesSent;
+    transport_getStats(&messagesSent, &bytesSent);
+    flog_d(stderr, "replay: %d messages sent", (int)messagesSent);
+    flog_d(stderr, "replay: %d bytes sent", (int)bytesSent);
+
+    transport_close();
+    game_close(gs);
+    catalog_delete(maps);
+    if(transcriptFP != NULL){
+      fclose(transcriptFP);
+    }
+    return 0;
+  }
+
+  // Open the recording, if asked to record
+  if(options.recordFile != NULL){
+    if((recordFP = fopen(options.recordFile, "w")) == NULL){
+      flog_v(stderr, "Could not open record file...\n");
+      exit(1);
+    }
+  }
 
   // Initialize network and get port number
   int port = message_init(stderr);
@@ -918,17 +1498,41 @@ main(const int argc, const char* argv[])
   }
 
 
-  // Start message loop
-  message_loop(
-    gs, /* Argument passed to all callbacks */
-    0.0,/* Timeout specifier (0 in our case) */
-    NULL,/* Handle Timeout function pointer (NULL in our case) */
-    NULL, /* Handle stdin (NULL in our case) */
-    handleMessage
-  );
+  // Start message loop; wake up to resend unacknowledged messages,
+  // and more often if need be to pace spectators
+  float timeout = transport_RetransmitInterval;
+  if(gs->spectatorInterval > 0 && gs->spectatorInterval < timeout){
+    timeout = gs->spectatorInterval;
+  }
+  while(true){
+    if(options.rotateDir != NULL){
+      nextMapPath = maps->paths[(currentMap + 1) % maps->numMaps];
+    }
+    bool ended = message_loop(
+      gs, /* Argument passed to all callbacks */
+      timeout,/* Timeout specifier */
+      handleTimeout,/* Handle Timeout function pointer */
+      NULL, /* Handle stdin (NULL in our case) */
+      recordFP != NULL ? recordMessage : handleMessage
+    );
+
+    // Free all gamestate and session memory
+    transport_close();
+    game_close(gs);
+
+    // When rotating, start the next game on the next map, already loaded
+    if(!ended || options.rotateDir == NULL){
+      break;
+    }
+    currentMap = (currentMap + 1) % maps->numMaps;
+    flog_s(stderr, "Next game on %s", maps->paths[currentMap]);
+    gs = game_init(catalog_share(maps, currentMap), &options);
+  }
+  catalog_delete(maps);
 
-  // Free all gamestate memory
-  game_close(gs);
+  if(recordFP != NULL){
+    fclose(recordFP);
+  }
 
   flog_done(stderr);
-}
\ No newline at end of file
+}
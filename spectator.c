@@ -15,11 +15,22 @@
 /* standard libraries */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "message.h"      /* message module */
+#include "transport.h"    /* transport module */
 #include "log.h"
 #include "spectator.h"    /* self */
 
+/******** static function prototypes *******/
+static char* buildDelta(const char* from, const char* to);
+
+/******** module constants *******/
+static const char DisplayHeader[] = "DISPLAY\n";
+static const int MinDeltaGap = 4;   /* unchanged characters that end a run */
+static const int KeyframeInterval = 30;   /* most DELTA frames between DISPLAYs */
+
 /**
  * @brief: constructor: allocates memory for the spectator struct
  * and initializes values
@@ -39,6 +50,11 @@ spectator_new(addr_t address)
   spectator_t* spectator = malloc(sizeof(spectator_t));
   if (spectator != NULL) {
     spectator->address = address;
+    spectator->lastFrameTime = 0;
+    spectator->frameVersion = -1;
+    spectator->frame = NULL;
+    spectator->framesSinceDisplay = 0;
+    spectator->shownRemaining = -1;
     return spectator;
   }
   /* if error occurred allocating memory, 
@@ -63,8 +79,94 @@ spectator_send(spectator_t* spectator, char* message)
   /* cannot send NULL message, 
      or to NULL spectator */
   if (spectator != NULL && message != NULL) {
-    message_send(spectator->address, message);
+    transport_send(spectator->address, message);
+  }
+}
+
+
+/**
+ * @brief: function to send a frame of the game to a spectator.
+ * See spectator.h for detailed documentation.
+ */
+void
+spectator_sendFrame(spectator_t* spectator, const char* display,
+                    int version, spectator_refresh_t refresh)
+{
+  if (spectator == NULL || display == NULL) {
+    return;
+  }
+
+  /* without deltas, there is nothing to remember but the version */
+  if (refresh != SPECTATOR_DELTA) {
+    transport_send(spectator->address, display);
+    spectator->frameVersion = version;
+    return;
+  }
+
+  /* a delta is only good if the frame it changes arrived,
+     and even then the whole frame is sent now and again */
+  bool canDelta = spectator->frame != NULL
+                  && strlen(spectator->frame) == strlen(display)
+                  && spectator->framesSinceDisplay < KeyframeInterval
+                  && transport_hasSession(spectator->address);
+  if (canDelta && strcmp(spectator->frame, display) == 0) {
+    spectator->frameVersion = version;    /* it shows this frame already */
+    return;
+  }
+
+  /* send a delta when the spectator has a frame the same shape, and it pays */
+  char* delta = NULL;
+  if (canDelta) {
+    delta = buildDelta(spectator->frame, display);
+  }
+  if (delta != NULL) {
+    transport_send(spectator->address, delta);
+    spectator->framesSinceDisplay++;
+  }
+  else {
+    transport_send(spectator->address, display);
+    spectator->framesSinceDisplay = 0;
+  }
+  free(delta);
+
+  /* remember what the spectator now sees */
+  char* frame = realloc(spectator->frame, strlen(display) + 1);
+  if (frame != NULL) {
+    strcpy(frame, display);
+    spectator->frame = frame;
+    spectator->frameVersion = version;
+  }
+  else {
+    free(spectator->frame);   /* can't remember it; next frame is in full */
+    spectator->frame = NULL;
+    spectator->frameVersion = -1;
+  }
+}
+
+
+/**
+ * @brief: function to parse the name of a refresh policy.
+ * See spectator.h for detailed documentation.
+ */
+bool
+spectator_parseRefresh(const char* name, spectator_refresh_t* refresh)
+{
+  if (name == NULL || refresh == NULL) {
+    return false;
+  }
+  if (strcmp(name, "every") == 0) {
+    *refresh = SPECTATOR_EVERY;
   }
+  else if (strcmp(name, "change") == 0) {
+    *refresh = SPECTATOR_ON_CHANGE;
+  }
+  else if (strcmp(name, "delta") == 0) {
+    *refresh = SPECTATOR_DELTA;
+  }
+  else {
+    return false;
+  }
+  return true;
 }
 
 
@@ -85,6 +187,75 @@ spectator_delete(spectator_t* spectator)
 {
   /* cannot free NULL spectator */
   if (spectator != NULL) {
+    free(spectator->frame);
     free(spectator);
   }
 }
+
+
+/**************** Static Functions ******************/
+
+/**
+ * @brief: builds a DELTA message taking one DISPLAY message, from,
+ * to another of the same length, to.
+ * A run of changes ends at the end of a row, or at MinDeltaGap
+ * unchanged characters, since a new run costs about that much.
+ * The caller must free the returned string.
+ *
+ * Returns:
+ * @return char*: the DELTA message.
+ * @return NULL: the delta would be no shorter than to, or error.
+ */
+static char*
+buildDelta(const char* from, const char* to)
+{
+  /* skip the headers; the frames are rows separated by newlines */
+  int header = strlen(DisplayHeader);
+  from += header;
+  to += header;
+
+  /* give up on the delta once it is as long as the frame */
+  int length = strlen(to);
+  int budget = header + length;
+  char* delta = malloc(budget + 1);
+  if (delta == NULL) {
+    return NULL;
+  }
+  int used = sprintf(delta, "DELTA");
+
+  int row = 0, col = 0;
+  for (int i = 0; i < length; ) {
+    if (to[i] == '\n') {
+      row++;
+      col = 0;
+      i++;
+      continue;
+    }
+    if (to[i] == from[i]) {
+      col++;
+      i++;
+      continue;
+    }
+
+    /* a changed run: extend it until MinDeltaGap unchanged, or end of row */
+    int start = i;
+    int end = i + 1;      /* one past the last changed character */
+    int j = i + 1;
+    while (j < length && to[j] != '\n' && j - end < MinDeltaGap) {
+      if (to[j] != from[j]) {
+        end = j + 1;
+      }
+      j++;
+    }
+    int needed = snprintf(NULL, 0, "\n%d %d %.*s", row, col, end - start, to + start);
+    if (used + needed >= budget) {
+      free(delta);
+      return NULL;
+    }
+    used += sprintf(delta + used, "\n%d %d %.*s", row, col, end - start, to + start);
+    col += end - start;
+    i = end;
+  }
+
+  return delta;
+}
@@ -18,16 +18,49 @@
 /* standard libraries */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "message.h"    /* message module */
 
+/**
+ * @brief: policies for refreshing spectators.
+ * SPECTATOR_EVERY: send a DISPLAY whenever the spectator is due a frame.
+ * SPECTATOR_ON_CHANGE: as above, but only if the frame has changed
+ * since the last one the spectator got.
+ * SPECTATOR_DELTA: as SPECTATOR_ON_CHANGE, but send only the parts
+ * of the frame that changed, as a DELTA message, when that is shorter.
+ * A DELTA is only good if the frame before it arrived, so spectators
+ * get them only over a reliable session (see transport_openSession()),
+ * and a full DISPLAY at least every KeyframeInterval frames
+ * (see spectator.c), so that one whose session was dropped
+ * is soon shown the whole game again.
+ * A DELTA message holds one line per changed run of a row:
+ *
+ *    DELTA
+ *    <row> <column> <characters>
+ *    ...
+ *
+ * where row and column (from 0) locate the first character of the run.
+ */
+typedef enum spectator_refresh {
+  SPECTATOR_EVERY,
+  SPECTATOR_ON_CHANGE,
+  SPECTATOR_DELTA
+} spectator_refresh_t;
+
 /**
  * @brief: struct to represent a spectator.
  * This struct hold their communication address,
- * through which the server sends game updates.
+ * through which the server sends game updates,
+ * and when they were last sent a frame of the game, and which.
  */
 typedef struct spectator {
   addr_t address;
+  double lastFrameTime;   /* game time (seconds) of the last frame sent; 0 if none */
+  int frameVersion;       /* version of the last frame sent; -1 if none */
+  char* frame;            /* copy of the last DISPLAY sent, kept for DELTA; may be NULL */
+  int framesSinceDisplay; /* DELTA frames sent since the last DISPLAY */
+  int shownRemaining;     /* nuggets left in the last GOLD sent; -1 if none */
 } spectator_t;
 
 
@@ -59,6 +92,43 @@ spectator_t* spectator_new(addr_t address);
 void spectator_send(spectator_t* spectator, char* message);
 
 
+/**
+ * @brief: function to send a frame of the game to a spectator,
+ * as a DISPLAY message or, with SPECTATOR_DELTA, as a DELTA
+ * from the last frame the spectator got, whichever is shorter.
+ * DELTA frames go only to spectators with a reliable session,
+ * and never more than KeyframeInterval in a row.
+ * 
+ * Inputs:
+ * @param spectator: pointer to a spectator struct
+ * @param display: the frame, as a DISPLAY message
+ * @param version: the version of the frame, recorded in the spectator
+ * @param refresh: the refresh policy
+ * 
+ * Returns: None.
+ * 
+ * NOTE: the caller decides whether the spectator is due a frame;
+ * this function always sends one, except that with SPECTATOR_DELTA
+ * nothing is sent if the frame is the one the spectator has.
+ */
+void spectator_sendFrame(spectator_t* spectator, const char* display,
+                         int version, spectator_refresh_t refresh);
+
+
+/**
+ * @brief: function to parse the name of a refresh policy.
+ * 
+ * Inputs:
+ * @param name: "every", "change" or "delta".
+ * @param refresh: filled in with the matching policy.
+ * 
+ * Returns:
+ * @return true: name matched a policy.
+ * @return false: unknown name; refresh is unchanged.
+ */
+bool spectator_parseRefresh(const char* name, spectator_refresh_t* refresh);
+
+
 /**
  * @brief: function to delete a spectator instance
  * and free all allocated memory.
@@ -76,8 +76,10 @@ file_readUntil(FILE* fp, int (*stopfunc)(int c))
     // We need to save buf[pos+1] for the terminating null
     // and buf[len-1] is the last usable slot, 
     // so if pos+1 is past that slot, we need to grow the buffer.
+    // Double it, so that long lines take linear time to read.
     if (pos+1 > len-1) {
-      char* newbuf = realloc(buf, ++len * sizeof(char));
+      len *= 2;
+      char* newbuf = realloc(buf, len * sizeof(char));
       if (newbuf == NULL) {
         free(buf);
         return NULL;
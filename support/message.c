@@ -309,7 +309,7 @@ message_loop(void* arg, const float timeout,
   struct timeval  timeoutval;     // timeval equivalent of parameter 'timeout'
   if (timeout > 0.0) {
     timeoutval.tv_sec  = (int)timeout;
-    timeoutval.tv_usec = timeout - (int)timeout;
+    timeoutval.tv_usec = (timeout - (int)timeout) * 1000000;
   }
 
   // loop until error or some handler indicates time to quit looping
@@ -350,8 +350,8 @@ message_loop(void* arg, const float timeout,
 	return false; // error
       }
     } else if (select_response == 0) {
-      // timeout occurred
-      log_v("message_loop: select() timed out");
+      // timeout occurred; not logged, as callers that ask for one
+      // (e.g. to retransmit) time out several times a second when idle
       if (handleTimeout != NULL && (*handleTimeout)(arg)) {
         break; // handler says to exit loop 
       }
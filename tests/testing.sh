@@ -30,6 +30,23 @@ make -C ../
 # invalid seed value
 ../server ../maps/main.txt WRONGSEED
 
+# replays: each recording in replays/, replayed with the map, seed and
+# options in its .args file, must send exactly what its .expected holds.
+# To record a new one, run the server with --record, play, and then
+#   ../server $(cat replays/x.args) --replay replays/x.rec --transcript replays/x.expected
+for recording in replays/*.rec; do
+  name="${recording%.rec}"
+  transcript=$(mktemp)
+  ../server $(cat "$name.args") --replay "$recording" --transcript "$transcript" 2> /dev/null
+  if cmp -s "$transcript" "$name.expected"; then
+    printf "replay $name: same messages sent\n"
+  else
+    printf "replay $name: FAILED, messages sent differ:\n"
+    diff "$name.expected" "$transcript" | head -20
+  fi
+  rm -f "$transcript"
+done
+
 # valid call
 
 ## launch server
@@ -0,0 +1,755 @@
+/**
+ * @file transport.c
+ * @author TEAM PINE
+ * @brief: implements functionality for the transport module.
+ * The transport module is the single point through which
+ * the game sends messages to clients, either over UDP
+ * or into a sink installed by the caller, plain or through
+ * a reliable session (numbered, acknowledged, and resent),
+ * with frames encoded as each client asked,
+ * the messages of an update batched for clients that asked,
+ * and messages too long for one datagram sent in fragments.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "message.h"      /* message module */
+#include "msgbuf.h"       /* msgbuf module */
+#include "transport.h"    /* self */
+
+/******** module constants *******/
+static const int FragmentHeaderBytes = 64;  /* room left for "FRAGMENT id index count\n" */
+
+/******** local types *******/
+/* a numbered message awaiting its acknowledgement */
+typedef struct pending {
+  int seq;            /* its number */
+  char* message;      /* the numbered message, as sent */
+  bool frame;         /* a DISPLAY or DELTA, made obsolete by a later DISPLAY */
+  double sentAt;      /* when last sent; < 0 until transport_retransmit() sees it */
+  int tries;          /* times resent */
+} pending_t;
+
+/* the encoding a client asked for */
+typedef struct encoding {
+  addr_t address;                   /* the client */
+  transport_encoding_t encoding;    /* how to encode its frames */
+} encoding_t;
+
+/* messages held for a client that asked for batches */
+typedef struct batch {
+  addr_t address;     /* the client */
+  msgbuf_t* held;     /* the messages held, each after its length line */
+  int count;          /* messages held */
+  size_t first;       /* where the first message starts in held */
+  bool fullFrame;     /* some message held is a DISPLAY or WINDOW */
+  bool allFrames;     /* every message held is a frame */
+} batch_t;
+
+/* a reliable session with one client */
+typedef struct session {
+  addr_t address;     /* the client */
+  int nextSeq;        /* number for the next message */
+  pending_t* pending; /* messages awaiting acknowledgement, oldest first */
+  int numPending;     /* entries in pending */
+  int capacity;       /* slots allocated in pending */
+} session_t;
+
+/******** static function prototypes *******/
+static void udpSink(void* arg, const addr_t to, const char* message);
+static void deliver(const addr_t to, const char* message);
+static void sendWire(const addr_t to, const char* wire, bool fullFrame, bool frame);
+static batch_t* findBatch(const addr_t address);
+static bool holdMessage(batch_t* batch, const char* wire);
+static session_t* findSession(const addr_t address);
+static bool addPending(session_t* session, int seq, char* message, bool frame);
+static void removePending(session_t* session, int index);
+static void closeSession(int index);
+static bool isFrame(const char* message);
+static transport_encoding_t findEncoding(const addr_t address);
+static char* encodeRLE(const char* message);
+
+/******** module variables *******/
+/* Like the socket in the message module, there is one transport
+ * per process; every game module sends through it. */
+static transport_sink_t sink = udpSink;   /* where messages go */
+static void* sinkArg = NULL;              /* passed through to the sink */
+static long messagesSent = 0;             /* messages sent so far */
+static long bytesSent = 0;                /* bytes sent so far */
+static session_t* sessions = NULL;        /* reliable sessions, in no order */
+static int numSessions = 0;               /* sessions in the array */
+static int sessionsCapacity = 0;          /* slots allocated in the array */
+static int nextFragmentId = 0;            /* id of the next fragmented message */
+static encoding_t* encodings = NULL;      /* clients not using TRANSPORT_PLAIN */
+static int numEncodings = 0;              /* entries in the array */
+static int encodingsCapacity = 0;         /* slots allocated in the array */
+static batch_t* batches = NULL;           /* clients that asked for batches */
+static int numBatches = 0;                /* entries in the array */
+static int batchesCapacity = 0;           /* slots allocated in the array */
+static msgbuf_t* batchWire = NULL;        /* where a batch is put together to send */
+
+/************** Exported functions ***************/
+
+/**
+ * @brief: function to install a sink for all outgoing messages.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_setSink(transport_sink_t newSink, void* arg)
+{
+  sink = (newSink != NULL) ? newSink : udpSink;
+  sinkArg = arg;
+}
+
+
+/**
+ * @brief: function to send a message to a client,
+ * through the installed sink.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_send(const addr_t to, const char* message)
+{
+  if (message == NULL) {
+    return;
+  }
+
+  /* encode frames for clients that asked for it */
+  bool display = (strncmp(message, "DISPLAY\n", 8) == 0);
+  bool fullFrame = display || strncmp(message, "WINDOW ", 7) == 0;
+  char* encoded = NULL;
+  if (display && numEncodings > 0 && findEncoding(to) == TRANSPORT_RLE) {
+    encoded = encodeRLE(message);
+  }
+  const char* wire = (encoded != NULL) ? encoded : message;
+
+  /* hold it until the update is flushed, for clients that asked */
+  batch_t* batch = (numBatches > 0) ? findBatch(to) : NULL;
+  if (batch != NULL && holdMessage(batch, wire)) {
+    batch->fullFrame = batch->fullFrame || fullFrame;
+    batch->allFrames = batch->allFrames && isFrame(message);
+    free(encoded);
+    return;
+  }
+
+  sendWire(to, wire, fullFrame, isFrame(message));
+  free(encoded);
+}
+
+
+/**
+ * @brief: function to send every batch of messages held back.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_flush(void)
+{
+  for (int i = 0; i < numBatches; i++) {
+    batch_t* batch = &batches[i];
+    if (batch->count == 0) {
+      continue;
+    }
+
+    /* a lone message needs no batch */
+    if (batch->count == 1) {
+      sendWire(batch->address, batch->held->text + batch->first,
+               batch->fullFrame, batch->allFrames);
+    } else if (batchWire != NULL || (batchWire = msgbuf_new(batch->held->length + 32)) != NULL) {
+      msgbuf_clear(batchWire);
+      msgbuf_append(batchWire, "BATCH ");
+      msgbuf_appendInt(batchWire, batch->count);
+      msgbuf_appendChar(batchWire, '\n');
+      msgbuf_append(batchWire, batch->held->text);
+      sendWire(batch->address, batchWire->text, batch->fullFrame, batch->allFrames);
+    }
+
+    msgbuf_clear(batch->held);
+    batch->count = 0;
+  }
+}
+
+
+/**
+ * @brief: function to choose whether messages to a client are batched.
+ * See transport.h for detailed documentation.
+ */
+bool
+transport_setBatching(const addr_t to, bool batching)
+{
+  /* update the client's entry, if it has one */
+  for (int i = 0; i < numBatches; i++) {
+    if (message_eqAddr(batches[i].address, to)) {
+      if (!batching) {
+        transport_flush();      /* what is held goes out first */
+        msgbuf_delete(batches[i].held);
+        batches[i] = batches[--numBatches];
+      }
+      return true;
+    }
+  }
+  if (!batching) {
+    return true;
+  }
+
+  /* grow the array as clients ask */
+  if (numBatches == batchesCapacity) {
+    int capacity = (batchesCapacity == 0) ? 4 : 2 * batchesCapacity;
+    batch_t* grown = realloc(batches, capacity * sizeof(batch_t));
+    if (grown == NULL) {
+      return false;
+    }
+    batches = grown;
+    batchesCapacity = capacity;
+  }
+  batch_t* batch = &batches[numBatches];
+  batch->held = msgbuf_new(256);
+  if (batch->held == NULL) {
+    return false;
+  }
+  batch->address = to;
+  batch->count = 0;
+  batch->first = 0;
+  numBatches++;
+  return true;
+}
+
+
+/**
+ * @brief: function to choose how frames sent to a client are encoded.
+ * See transport.h for detailed documentation.
+ */
+bool
+transport_setEncoding(const addr_t to, transport_encoding_t encoding)
+{
+  /* update the client's entry, if it has one */
+  for (int i = 0; i < numEncodings; i++) {
+    if (message_eqAddr(encodings[i].address, to)) {
+      if (encoding == TRANSPORT_PLAIN) {
+        encodings[i] = encodings[--numEncodings];
+      } else {
+        encodings[i].encoding = encoding;
+      }
+      return true;
+    }
+  }
+  if (encoding == TRANSPORT_PLAIN) {
+    return true;
+  }
+
+  /* grow the array as clients ask */
+  if (numEncodings == encodingsCapacity) {
+    int capacity = (encodingsCapacity == 0) ? 4 : 2 * encodingsCapacity;
+    encoding_t* grown = realloc(encodings, capacity * sizeof(encoding_t));
+    if (grown == NULL) {
+      return false;
+    }
+    encodings = grown;
+    encodingsCapacity = capacity;
+  }
+  encodings[numEncodings].address = to;
+  encodings[numEncodings].encoding = encoding;
+  numEncodings++;
+  return true;
+}
+
+
+/**
+ * @brief: function to parse the name of an encoding.
+ * See transport.h for detailed documentation.
+ */
+bool
+transport_parseEncoding(const char* name, transport_encoding_t* encoding)
+{
+  if (name == NULL) {
+    return false;
+  }
+  if (strcmp(name, "PLAIN") == 0) {
+    *encoding = TRANSPORT_PLAIN;
+  } else if (strcmp(name, "RLE") == 0) {
+    *encoding = TRANSPORT_RLE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+
+/**
+ * @brief: a sink that drops every message.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_discard(void* arg, const addr_t to, const char* message)
+{
+}
+
+
+/**
+ * @brief: a sink that writes every message to a file.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_print(void* arg, const addr_t to, const char* message)
+{
+  FILE* fp = arg;
+  fprintf(fp, "TO %s:%d\n%s\n", inet_ntoa(to.sin_addr), ntohs(to.sin_port), message);
+}
+
+
+/**
+ * @brief: function to start a reliable session with a client.
+ * See transport.h for detailed documentation.
+ */
+bool
+transport_openSession(const addr_t to)
+{
+  if (findSession(to) != NULL) {
+    return true;
+  }
+
+  /* grow the array as clients opt in */
+  if (numSessions == sessionsCapacity) {
+    int capacity = (sessionsCapacity == 0) ? 4 : 2 * sessionsCapacity;
+    session_t* grown = realloc(sessions, capacity * sizeof(session_t));
+    if (grown == NULL) {
+      return false;
+    }
+    sessions = grown;
+    sessionsCapacity = capacity;
+  }
+
+  session_t* session = &sessions[numSessions++];
+  session->address = to;
+  session->nextSeq = 1;
+  session->pending = NULL;
+  session->numPending = 0;
+  session->capacity = 0;
+  return true;
+}
+
+
+/**
+ * @brief: function to check whether a client has a reliable session.
+ * See transport.h for detailed documentation.
+ */
+bool
+transport_hasSession(const addr_t to)
+{
+  return findSession(to) != NULL;
+}
+
+
+/**
+ * @brief: function to take note of a client's acknowledgement.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_ack(const addr_t from, int seq)
+{
+  session_t* session = findSession(from);
+  if (session == NULL) {
+    return;
+  }
+  for (int i = 0; i < session->numPending; i++) {
+    if (session->pending[i].seq == seq) {
+      removePending(session, i);
+      return;
+    }
+  }
+}
+
+
+/**
+ * @brief: function to resend every message that has waited
+ * too long for its acknowledgement.
+ * See transport.h for detailed documentation.
+ */
+int
+transport_retransmit(double now)
+{
+  int resent = 0;
+
+  for (int s = numSessions - 1; s >= 0; s--) {
+    session_t* session = &sessions[s];
+    bool givenUp = false;
+
+    for (int i = 0; i < session->numPending; i++) {
+      pending_t* pending = &session->pending[i];
+      if (pending->sentAt < 0) {
+        pending->sentAt = now;    /* first seen since it was sent */
+      } else if (now - pending->sentAt >= transport_RetransmitInterval) {
+        if (pending->tries >= transport_MaxRetransmits) {
+          givenUp = true;
+          break;
+        }
+        deliver(session->address, pending->message);
+        pending->sentAt = now;
+        pending->tries++;
+        resent++;
+      }
+    }
+
+    /* the client is not listening; stop numbering its messages */
+    if (givenUp) {
+      closeSession(s);
+    }
+  }
+  return resent;
+}
+
+
+/**
+ * @brief: function to send what is held, end every session,
+ * forget every encoding and batch, and free their memory.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_close(void)
+{
+  transport_flush();
+  for (int i = 0; i < numBatches; i++) {
+    msgbuf_delete(batches[i].held);
+  }
+  free(batches);
+  batches = NULL;
+  numBatches = 0;
+  batchesCapacity = 0;
+  msgbuf_delete(batchWire);
+  batchWire = NULL;
+
+  while (numSessions > 0) {
+    closeSession(numSessions - 1);
+  }
+  free(sessions);
+  sessions = NULL;
+  sessionsCapacity = 0;
+
+  free(encodings);
+  encodings = NULL;
+  numEncodings = 0;
+  encodingsCapacity = 0;
+}
+
+
+/**
+ * @brief: function to get the number of messages, and bytes,
+ * sent through the transport so far.
+ * See transport.h for detailed documentation.
+ */
+void
+transport_getStats(long* messages, long* bytes)
+{
+  if (messages != NULL) {
+    *messages = messagesSent;
+  }
+  if (bytes != NULL) {
+    *bytes = bytesSent;
+  }
+}
+
+
+/**************** Static Functions ******************/
+
+/**
+ * @brief: the default sink; sends the message over UDP.
+ */
+static void
+udpSink(void* arg, const addr_t to, const char* message)
+{
+  message_send(to, message);
+}
+
+
+/**
+ * @brief: counts a message and hands it to the sink;
+ * in fragments if it is too long for one datagram.
+ */
+static void
+deliver(const addr_t to, const char* message)
+{
+  size_t length = strlen(message);
+  if (length <= message_MaxBytes) {
+    messagesSent++;
+    bytesSent += length;
+    (*sink)(sinkArg, to, message);
+    return;
+  }
+
+  /* split it into parts that fit, each with its header */
+  int partBytes = message_MaxBytes - FragmentHeaderBytes;
+  int count = (length + partBytes - 1) / partBytes;
+  int id = nextFragmentId++;
+  char* fragment = malloc(message_MaxBytes + 1);
+  if (fragment == NULL) {
+    return;
+  }
+  for (int index = 0; index < count; index++) {
+    size_t offset = (size_t)index * partBytes;
+    size_t part = (length - offset < partBytes) ? length - offset : partBytes;
+    int header = sprintf(fragment, "FRAGMENT %d %d %d\n", id, index, count);
+    memcpy(fragment + header, message + offset, part);
+    fragment[header + part] = '\0';
+
+    messagesSent++;
+    bytesSent += header + part;
+    (*sink)(sinkArg, to, fragment);
+  }
+  free(fragment);
+}
+
+
+/**
+ * @brief: numbers a message (already encoded) for clients in a reliable
+ * session, queueing it to await its acknowledgement, and delivers it.
+ * fullFrame says it makes earlier frames obsolete; frame, that a later
+ * full frame may make it obsolete.
+ */
+static void
+sendWire(const addr_t to, const char* wire, bool fullFrame, bool frame)
+{
+  session_t* session = findSession(to);
+  if (session == NULL) {
+    deliver(to, wire);
+    return;
+  }
+
+  /* number the message */
+  int seq = session->nextSeq++;
+  char* numbered = malloc(strlen(wire) + 20);
+  if (numbered == NULL) {
+    deliver(to, wire);
+    return;
+  }
+  sprintf(numbered, "SEQ %d %s", seq, wire);
+
+  /* a full frame replaces any frame still awaiting acknowledgement */
+  if (fullFrame) {
+    for (int i = session->numPending - 1; i >= 0; i--) {
+      if (session->pending[i].frame) {
+        removePending(session, i);
+      }
+    }
+  }
+
+  deliver(to, numbered);
+  if (!addPending(session, seq, numbered, frame)) {
+    free(numbered);
+  }
+}
+
+
+/**
+ * @brief: finds the batch held for a client.
+ *
+ * Returns:
+ * @return batch_t*: the batch, valid until clients start or stop batching.
+ * @return NULL: the client did not ask for batches.
+ */
+static batch_t*
+findBatch(const addr_t address)
+{
+  for (int i = 0; i < numBatches; i++) {
+    if (message_eqAddr(batches[i].address, address)) {
+      return &batches[i];
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * @brief: appends a message to a client's batch, after its length line,
+ * in the format described in transport.h.
+ *
+ * Returns:
+ * @return true: held, to be sent by transport_flush().
+ * @return false: out of memory; the batch is unchanged.
+ */
+static bool
+holdMessage(batch_t* batch, const char* wire)
+{
+  msgbuf_t* held = batch->held;
+  size_t length = strlen(wire);
+  if (!msgbuf_reserve(held, length + 24)) {
+    return false;
+  }
+
+  msgbuf_appendInt(held, (int)length);
+  msgbuf_appendChar(held, '\n');
+  if (batch->count == 0) {
+    batch->first = held->length;
+    batch->fullFrame = false;
+    batch->allFrames = true;
+  }
+  msgbuf_append(held, wire);
+  batch->count++;
+  return true;
+}
+
+
+/**
+ * @brief: finds the session with a client.
+ *
+ * Returns:
+ * @return session_t*: the session, valid until sessions are opened or closed.
+ * @return NULL: the client has no session.
+ */
+static session_t*
+findSession(const addr_t address)
+{
+  for (int i = 0; i < numSessions; i++) {
+    if (message_eqAddr(sessions[i].address, address)) {
+      return &sessions[i];
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * @brief: queues a numbered message to await its acknowledgement;
+ * the session takes over the message.
+ *
+ * Returns:
+ * @return true: queued.
+ * @return false: out of memory; the caller still owns the message.
+ */
+static bool
+addPending(session_t* session, int seq, char* message, bool frame)
+{
+  if (session->numPending == session->capacity) {
+    int capacity = (session->capacity == 0) ? 8 : 2 * session->capacity;
+    pending_t* grown = realloc(session->pending, capacity * sizeof(pending_t));
+    if (grown == NULL) {
+      return false;
+    }
+    session->pending = grown;
+    session->capacity = capacity;
+  }
+
+  pending_t* pending = &session->pending[session->numPending++];
+  pending->seq = seq;
+  pending->message = message;
+  pending->frame = frame;
+  pending->sentAt = -1;
+  pending->tries = 0;
+  return true;
+}
+
+
+/**
+ * @brief: drops a message from the queue, keeping the rest in order.
+ */
+static void
+removePending(session_t* session, int index)
+{
+  free(session->pending[index].message);
+  session->numPending--;
+  memmove(&session->pending[index], &session->pending[index + 1],
+          (session->numPending - index) * sizeof(pending_t));
+}
+
+
+/**
+ * @brief: ends a session, freeing its queue;
+ * the last session takes its place in the array.
+ */
+static void
+closeSession(int index)
+{
+  session_t* session = &sessions[index];
+  for (int i = 0; i < session->numPending; i++) {
+    free(session->pending[i].message);
+  }
+  free(session->pending);
+  sessions[index] = sessions[--numSessions];
+}
+
+
+/**
+ * @brief: finds the encoding a client asked for.
+ */
+static transport_encoding_t
+findEncoding(const addr_t address)
+{
+  for (int i = 0; i < numEncodings; i++) {
+    if (message_eqAddr(encodings[i].address, address)) {
+      return encodings[i].encoding;
+    }
+  }
+  return TRANSPORT_PLAIN;
+}
+
+
+/**
+ * @brief: run-length encodes a DISPLAY message, in the format
+ * described in transport.h.
+ *
+ * Returns:
+ * @return char*: the encoded message, for the caller to free.
+ * @return NULL: encoding would not make it shorter, or out of memory.
+ */
+static char*
+encodeRLE(const char* message)
+{
+  const char* frame = message + strlen("DISPLAY\n");
+  int length = strlen(message);
+
+  /* at worst every character is a doubled '~' */
+  char* encoded = malloc(2 * length + 20);
+  if (encoded == NULL) {
+    return NULL;
+  }
+  char* out = encoded + sprintf(encoded, "DISPLAY RLE\n");
+
+  for (const char* p = frame; *p != '\0'; ) {
+    char c = *p;
+    int run = 1;
+    while (p[run] == c) {
+      run++;
+    }
+
+    if (c == '~') {
+      /* escape each one */
+      for (int i = 0; i < run; i++) {
+        *out++ = '~';
+        *out++ = '~';
+      }
+    } else if (c != '\n' && run >= 5) {
+      /* "~cn~" is shorter than 5 or more c's */
+      out += sprintf(out, "~%c%d~", c, run);
+    } else {
+      memcpy(out, p, run);
+      out += run;
+    }
+    p += run;
+  }
+  *out = '\0';
+
+  if (out - encoded >= length) {
+    free(encoded);
+    return NULL;
+  }
+  return encoded;
+}
+
+
+/**
+ * @brief: whether a message is a frame of the map: DISPLAY, WINDOW or DELTA.
+ */
+static bool
+isFrame(const char* message)
+{
+  return strncmp(message, "DISPLAY\n", 8) == 0
+         || strncmp(message, "WINDOW ", 7) == 0
+         || strncmp(message, "DELTA\n", 6) == 0;
+}
@@ -0,0 +1,315 @@
+/**
+ * @file transport.h
+ * @author TEAM PINE
+ * @brief: exports functionality for the transport module.
+ * The transport module is the single point through which
+ * the game sends messages to clients.
+ * By default messages go out over UDP via the message module,
+ * but the caller may install a sink instead, so that a game
+ * can run in-process (simulators, fuzzers, benchmarks, replays)
+ * without any sockets or system calls.
+ * Clients may also ask for a reliable session, over whatever sink:
+ * messages to them are then numbered, acknowledged, and resent
+ * until acknowledged, unless a newer frame makes them obsolete;
+ * for DISPLAY frames to be run-length encoded,
+ * and for the messages of each update to come in one datagram.
+ * Messages too long for one datagram are sent in fragments.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef __TRANSPORT_H
+#define __TRANSPORT_H
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "message.h"    /* message module */
+
+/**
+ * Reliable sessions. A client opts in by sending
+ *
+ *    RELIABLE
+ *
+ * and from then on every message sent to it is numbered:
+ *
+ *    SEQ <n> <message>
+ *
+ * with n counting up from 1. The client answers each with
+ *
+ *    ACK <n>
+ *
+ * and should act on each number once, as messages may arrive
+ * more than once, and out of order.
+ * Messages not acknowledged within transport_RetransmitInterval seconds
+ * are sent again, up to transport_MaxRetransmits times, after which
+ * the session is dropped and messages to the client are sent plain.
+ * A full DISPLAY (or WINDOW) frame makes earlier DISPLAY, WINDOW and DELTA
+ * messages to the same client obsolete: those are no longer resent,
+ * so their numbers may never arrive, and clients should ignore a frame
+ * that arrives after a later-numbered full frame. DELTA messages are never made obsolete
+ * by one another, so a client can hold them back and apply them in order.
+ */
+static const float transport_RetransmitInterval = 0.25;   /* seconds */
+static const int transport_MaxRetransmits = 8;
+
+
+/**
+ * Fragments. A message longer than message_MaxBytes (a DISPLAY frame
+ * of a map larger than about 250 x 250) cannot go in one datagram,
+ * so it is sent as consecutive fragments, each
+ *
+ *    FRAGMENT <id> <index> <count>
+ *    <part>
+ *
+ * where id is the same for every fragment of the message (and differs
+ * between messages), index counts from 0 to count-1, and the message
+ * is the parts joined in order. A client should drop a message if any
+ * of its fragments is missing; with a reliable session, the whole
+ * message is resent (as new fragments, under a new id).
+ * Fragmenting happens last, after encoding, batching and numbering.
+ */
+
+
+/**
+ * Encodings. A client that understands run-length encoded frames sends
+ *
+ *    ENCODING RLE
+ *
+ * before PLAY or SPECTATE, and is then sent each DISPLAY frame as
+ *
+ *    DISPLAY RLE
+ *    <encoded frame>
+ *
+ * whenever that is shorter (and as a plain DISPLAY otherwise).
+ * In the encoded frame, a run of a character c repeated n times is
+ * written "~cn~" (n in decimal, e.g. "~ 40~" for 40 blanks),
+ * a literal '~' is written "~~", and every other character stands
+ * for itself. Runs never include newlines or '~'.
+ */
+typedef enum transport_encoding {
+  TRANSPORT_PLAIN,      /* frames as they are */
+  TRANSPORT_RLE         /* frames run-length encoded, when shorter */
+} transport_encoding_t;
+
+
+/**
+ * Batches. A client that sends
+ *
+ *    BATCH
+ *
+ * is sent the messages for it from each update (e.g. a DISPLAY
+ * and the GOLD that goes with it) together, in one datagram, as
+ *
+ *    BATCH <count>
+ *    <length>
+ *    <message><length>
+ *    <message>
+ *
+ * and so on: each of the count messages follows a line giving its
+ * length in bytes, and is followed directly by the next length line.
+ * An update with a single message for the client sends it as is.
+ * Messages are held from transport_send() until transport_flush();
+ * batching happens after encoding, and before numbering, so a batch
+ * is acknowledged, resent, and made obsolete as one message (only when
+ * all of it is frames).
+ */
+
+
+/**
+ * @brief: a sink receives every message the game sends.
+ * arg is the pointer given to transport_setSink(), passed through untouched.
+ * The sink must not retain the message pointer after returning.
+ */
+typedef void (*transport_sink_t)(void* arg, const addr_t to, const char* message);
+
+
+/**
+ * @brief: function to install a sink for all outgoing messages.
+ *
+ * Inputs:
+ * @param sink: the sink; NULL restores the default (UDP via message_send).
+ * @param arg: pointer passed through to every call of the sink.
+ *
+ * Returns: None.
+ */
+void transport_setSink(transport_sink_t sink, void* arg);
+
+
+/**
+ * @brief: function to send a message to a client,
+ * through the installed sink.
+ *
+ * Inputs:
+ * @param to: address of the client.
+ * @param message: the message to send.
+ *
+ * Returns: None.
+ *
+ * NOTE: we do not free any of the pointers passed in.
+ */
+void transport_send(const addr_t to, const char* message);
+
+
+/**
+ * @brief: a sink that drops every message.
+ * Install it with transport_setSink(transport_discard, NULL)
+ * to run a game headless.
+ */
+void transport_discard(void* arg, const addr_t to, const char* message);
+
+
+/**
+ * @brief: a sink that writes every message to a file, as
+ *
+ *    TO <host>:<port>
+ *    <message>
+ *
+ * Install it with transport_setSink(transport_print, fp),
+ * where fp is open for writing, to keep a transcript of a game
+ * run headless, e.g. to compare two replays of one recording.
+ */
+void transport_print(void* arg, const addr_t to, const char* message);
+
+
+/**
+ * @brief: function to choose how frames sent to a client are encoded.
+ *
+ * Inputs:
+ * @param to: address of the client.
+ * @param encoding: the encoding it understands.
+ *
+ * Returns:
+ * @return true: frames to the client will be so encoded.
+ * @return false: out of memory; frames to the client stay plain.
+ */
+bool transport_setEncoding(const addr_t to, transport_encoding_t encoding);
+
+
+/**
+ * @brief: function to choose whether messages to a client are held,
+ * and sent in batches by transport_flush().
+ *
+ * Inputs:
+ * @param to: address of the client.
+ * @param batching: true if the client asked for batches.
+ *
+ * Returns:
+ * @return true: messages to the client will be so sent.
+ * @return false: out of memory; messages to the client go out one by one.
+ */
+bool transport_setBatching(const addr_t to, bool batching);
+
+
+/**
+ * @brief: function to send, in one datagram per client, the messages
+ * held for clients that asked for batches. Call it at the end
+ * of each update: after handling each message, and when idle.
+ *
+ * Returns: None.
+ */
+void transport_flush(void);
+
+
+/**
+ * @brief: function to parse the name of an encoding, as sent by clients.
+ *
+ * Inputs:
+ * @param name: "PLAIN" or "RLE".
+ * @param encoding: filled in with the encoding.
+ *
+ * Returns:
+ * @return true: name is valid.
+ * @return false: name is NULL or unknown; *encoding is unchanged.
+ */
+bool transport_parseEncoding(const char* name, transport_encoding_t* encoding);
+
+
+/**
+ * @brief: function to start a reliable session with a client:
+ * every later message to it is numbered and resent until acknowledged.
+ *
+ * Inputs:
+ * @param to: address of the client.
+ *
+ * Returns:
+ * @return true: the session is open (or already was).
+ * @return false: out of memory; messages to the client stay plain.
+ */
+bool transport_openSession(const addr_t to);
+
+
+/**
+ * @brief: function to check whether a client has a reliable session,
+ * so that every message sent to it will arrive, or the session end.
+ *
+ * Inputs:
+ * @param to: address of the client.
+ *
+ * Returns:
+ * @return true: the client has a session open.
+ * @return false: it never asked for one, or the session was dropped.
+ */
+bool transport_hasSession(const addr_t to);
+
+
+/**
+ * @brief: function to take note of a client's acknowledgement.
+ *
+ * Inputs:
+ * @param from: address of the client.
+ * @param seq: the number of the message it acknowledges.
+ *
+ * Returns: None.
+ *
+ * NOTE: acknowledgements from clients without a session,
+ * and of messages not awaiting one, are ignored.
+ */
+void transport_ack(const addr_t from, int seq);
+
+
+/**
+ * @brief: function to resend every message that has waited
+ * transport_RetransmitInterval seconds for its acknowledgement.
+ * Call it regularly: after handling each message, and when idle.
+ *
+ * Inputs:
+ * @param now: the time, in seconds. Messages sent since the last call
+ * are taken to have been sent at this time.
+ *
+ * Returns:
+ * @return int: the number of messages resent.
+ */
+int transport_retransmit(double now);
+
+
+/**
+ * @brief: function to send any batches held, end every session,
+ * forget every client's encoding and batching, and free their memory,
+ * e.g. at the end of the game.
+ *
+ * Returns: None.
+ */
+void transport_close(void);
+
+
+/**
+ * @brief: function to get the number of messages, and bytes,
+ * sent through the transport so far, whatever the sink.
+ *
+ * Messages resent by reliable sessions count each time they are sent.
+ *
+ * Inputs:
+ * @param messages: filled in with the number of messages sent (may be NULL).
+ * @param bytes: filled in with the number of bytes sent (may be NULL).
+ *
+ * Returns: None.
+ */
+void transport_getStats(long* messages, long* bytes);
+
+#endif /* __TRANSPORT_H */